@@ -0,0 +1,155 @@
+/* Scaling of the built-in locks.
+ *
+ * Every thread puts and gets elements of its own owner. The owner holds one
+ * element put before the timing, so it isn't added and retired on every
+ * iteration, and owner locks are measured on the shared path. The benchmark
+ * prints millions of operations per second for each lock and number of
+ * threads, and for flat combining over the adaptive mutex:
+ *
+ *   bench_locks [max threads] [operations per thread]
+ *
+ * It fails if a thread gets an element, which it hasn't put. */
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+#define BUFFER_SIZE   512
+#define OWNER_LOCKS   16
+#define THREADS_LIMIT 128
+
+struct linked_ring buffer;
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+pthread_barrier_t start;
+size_t            operations = 100000;
+size_t            mismatches;
+
+struct lr_ticket_lock   ticket;
+struct lr_mcs_lock      mcs;
+struct lr_adaptive_lock adaptive;
+pthread_mutex_t         mutex = PTHREAD_MUTEX_INITIALIZER;
+struct lr_ticket_lock   owner_tickets[OWNER_LOCKS];
+struct lr_adaptive_lock owner_adaptives[OWNER_LOCKS];
+struct lr_combine_slot  slots[THREADS_LIMIT];
+
+void *put_get(void *arg)
+{
+    lr_owner_t owner = (lr_owner_t) (uintptr_t) arg;
+    lr_data_t  data;
+    size_t     errors = 0;
+
+    pthread_barrier_wait(&start);
+
+    for(size_t idx = 0; idx < operations; idx++) {
+        while(lr_put(&buffer, idx + 1, owner) != LR_OK) {
+        }
+
+        /* The element put by the previous iteration is got */
+        if(lr_get(&buffer, &data, owner) != LR_OK || data != idx) {
+            errors++;
+        }
+    }
+
+    __atomic_fetch_add(&mismatches, errors, __ATOMIC_RELAXED);
+
+    return NULL;
+}
+
+/* Millions of put and get pairs per second done by the threads */
+double run(struct lr_mutex_attr *attr, int combining, size_t threads_nr)
+{
+    pthread_t       threads[THREADS_LIMIT];
+    struct timespec begin, end;
+    double          seconds;
+    size_t          slots_nr;
+
+    lr_init(&buffer, BUFFER_SIZE, cells);
+    lr_set_mutex(&buffer, attr);
+    for(slots_nr = 1; slots_nr < threads_nr; slots_nr *= 2) {
+    }
+    lr_set_combining(&buffer, combining ? slots : NULL, slots_nr);
+    pthread_barrier_init(&start, NULL, threads_nr + 1);
+
+    /* Owners are kept alive by the first element */
+    for(size_t idx = 0; idx < threads_nr; idx++) {
+        lr_put(&buffer, 0, idx + 1);
+    }
+
+    for(size_t idx = 0; idx < threads_nr; idx++) {
+        pthread_create(&threads[idx], NULL, put_get,
+                       (void *) (uintptr_t) (idx + 1));
+    }
+
+    /* Threads may run as soon as the barrier opens */
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    pthread_barrier_wait(&start);
+    for(size_t idx = 0; idx < threads_nr; idx++) {
+        pthread_join(threads[idx], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    pthread_barrier_destroy(&start);
+
+    seconds = (end.tv_sec - begin.tv_sec) + (end.tv_nsec - begin.tv_nsec) / 1e9;
+
+    return threads_nr * operations / seconds / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t threads_max = 64;
+    struct {
+        const char          *name;
+        struct lr_mutex_attr attr;
+        int                  combining;
+    } locks[] = {
+        {"ticket", LR_MUTEX_TICKET(&ticket), 0},
+        {"mcs", LR_MUTEX_MCS(&mcs), 0},
+        {"adaptive", LR_MUTEX_ADAPTIVE(&adaptive), 0},
+        {"pthread", LR_MUTEX_PTHREAD(&mutex), 0},
+        {"owner_ticket", LR_OWNER_MUTEX_TICKET(owner_tickets, OWNER_LOCKS), 0},
+        {"owner_adaptive", LR_OWNER_MUTEX_ADAPTIVE(owner_adaptives, OWNER_LOCKS), 0},
+        {"combining", LR_MUTEX_ADAPTIVE(&adaptive), 1},
+    };
+    size_t locks_nr = sizeof(locks) / sizeof(locks[0]);
+
+    if(argc > 1) {
+        threads_max = strtoul(argv[1], NULL, 10);
+    }
+    if(argc > 2) {
+        operations = strtoul(argv[2], NULL, 10);
+    }
+    if(threads_max == 0 || threads_max > THREADS_LIMIT) {
+        threads_max = THREADS_LIMIT;
+    }
+
+    printf("threads");
+    for(size_t lock = 0; lock < locks_nr; lock++) {
+        printf("\t%s", locks[lock].name);
+    }
+    printf("\n");
+
+    for(size_t threads_nr = 1; threads_nr <= threads_max; threads_nr *= 2) {
+        printf("%zu", threads_nr);
+        for(size_t lock = 0; lock < locks_nr; lock++) {
+            printf("\t%.2f", run(&locks[lock].attr, locks[lock].combining, threads_nr));
+            fflush(stdout);
+        }
+        printf("\n");
+    }
+
+    if(mismatches) {
+        printf("%zu elements mismatched\n", mismatches);
+
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
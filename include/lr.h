@@ -2,24 +2,136 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#if defined(LR_WAIT_FUTEX)
+    #include <time.h>
+#endif
 
 
+/* Cells are linked with pointers by default. Define `LR_CELL_INDEX_BITS` as 16
+ * or 32 to link cells with indexes in the cells array instead, and
+ * `LR_CELL_DATA_BITS` as 16 or 32 to narrow the data (index width is used if
+ * not defined). It gives 4, 6 or 8 bytes cells, while the buffer is limited to
+ * 2^bits - 1 cells and owners are stored as `lr_data_t`. */
+#if defined(LR_CELL_INDEX_BITS)
+    #if LR_CELL_INDEX_BITS == 16
+        #define lr_index_t uint16_t
+    #elif LR_CELL_INDEX_BITS == 32
+        #define lr_index_t uint32_t
+    #else
+        #error "LR_CELL_INDEX_BITS should be 16 or 32"
+    #endif
+
+    /* Index which doesn't point to a cell */
+    #define LR_CELL_NIL ((lr_index_t) -1)
+
+    #if !defined(LR_CELL_DATA_BITS)
+        #define LR_CELL_DATA_BITS LR_CELL_INDEX_BITS
+    #endif
+
+    /* Cell without padding when data and index have different width. Links
+     * of most cells aren't aligned then, so they aren't accessed with
+     * atomics: the lock-free pool isn't available and owner locks are
+     * refused by `lr_set_mutex()` */
+    #if LR_CELL_DATA_BITS != LR_CELL_INDEX_BITS
+        #define LR_CELL_PACKED __attribute__((packed))
+        #define LR_CELL_UNALIGNED
+    #endif
+#endif
+
+#if !defined(LR_CELL_PACKED)
+    #define LR_CELL_PACKED
+#endif
+
+/* Define `LR_CELL_SOA` to store links and data of cells in separate arrays.
+ * Walks over the chains touch only the links then, and data of sequentially
+ * linked cells is contiguous. The buffer is initialized with `lr_init_soa()`
+ * instead of `lr_init()`. */
+
+/* Define `LR_POOL_LOCKFREE` to keep released cells in a lock-free stack.
+ * `lr_put()` takes the cell before the ring is locked and `lr_get()` returns
+ * it after the ring is unlocked, so the lock is held only to relink chains.
+ * The top of the stack is tagged with a generation, which is changed by every
+ * operation, so the stack doesn't suffer from ABA. Links of cells are
+ * accessed with relaxed atomics then. */
+
+/* Define `LR_POOL_MAGAZINE` to cache free cells in thread local magazines on
+ * top of the lock-free stack, which it implies. Threads take cells from their
+ * magazine and refill it from the stack in batches, released cells are cached
+ * while magazines hold less than half of free cells, so the shared stack is
+ * touched once per batch. Cached cells are free and counted by
+ * `lr_available()`, `cached` of the ring tells how many of them are in
+ * magazines. Magazine of the thread is returned to the ring when the thread
+ * exits or switches to other ring, and with `lr_magazine_flush()`, which
+ * should be called before the ring is released. */
+#if defined(LR_POOL_MAGAZINE) && !defined(LR_POOL_LOCKFREE)
+    #define LR_POOL_LOCKFREE
+#endif
+#if defined(LR_POOL_LOCKFREE) && defined(LR_CELL_UNALIGNED)
+    #error "LR_POOL_LOCKFREE needs aligned links, LR_CELL_DATA_BITS should be LR_CELL_INDEX_BITS"
+#endif
+
+/* Define `LR_WAIT_FUTEX` on Linux to block in `lr_get_wait()` and
+ * `lr_put_wait()` instead of polling. Waiters sleep on a futex word of the
+ * owner or on the word of free cells, which are supplied with
+ * `lr_set_wait()`, and are woken only when the owner gets data or cells are
+ * released. */
+
+/* Define `LR_EVENTFD` on Linux to signal eventfds for event loops. An eventfd
+ * bound to the owner with `lr_bind_eventfd()` is signalled when the owner
+ * gets data while it has none, and eventfds of the ring set with
+ * `lr_set_eventfd()` are signalled when the ring becomes non-empty and when
+ * it stops being full. */
+
+/* Define `LR_CELL_TIME` to stamp cells with the time the element was added,
+ * the stamp is kept first in the cell, so data and link stay together, and
+ * widens it by `lr_time_t`. Elements older than the TTL of the ring or of
+ * their owner, see `lr_set_ttl()` and `lr_set_owner_ttl()`, are expired by
+ * `lr_expire()` with bounded work per call, and by `lr_put()` when free
+ * cells run out. Time is taken from the clock of the ring, milliseconds of
+ * the monotonic clock by default. */
+#if defined(LR_CELL_TIME)
+    #define lr_time_t uint64_t
+
+    /* Cells checked for expiry by `lr_put()` when free cells run out */
+    #if !defined(LR_EXPIRE_BUDGET)
+        #define LR_EXPIRE_BUDGET 8
+    #endif
+#endif
+
 /* `lr_data_t` is a typedef for the `uintptr_t` type, which is an unsigned
  * integer type that is large enough to hold a pointer value. It is used to
  * store the data for each element in the Linked Ring buffer.  */
-#define lr_data_t uintptr_t
+#if !defined(LR_CELL_DATA_BITS)
+    #define lr_data_t uintptr_t
+#elif LR_CELL_DATA_BITS == 16
+    #define lr_data_t uint16_t
+#elif LR_CELL_DATA_BITS == 32
+    #define lr_data_t uint32_t
+#else
+    #error "LR_CELL_DATA_BITS should be 16 or 32"
+#endif
 /* The `lr_data` macro is provided as a convenience for casting a pointer to the
  * `lr_data_t` type. This macro is useful for ensuring that the data is stored
  * as an unsigned integer, rather than a pointer, which may be necessary for
  * certain operations on the data. */
-#define lr_data(ptr) (uintptr_t) ptr
+#define lr_data(ptr) (lr_data_t) (uintptr_t) ptr
+
+/* Cells written with `lr_write()` pack up to `LR_CELL_BYTES` bytes of the
+ * stream into the data, the lowest byte keeps the number of bytes in the cell.
+ * It gives 7 bytes per cell with pointer sized data. */
+#define LR_CELL_BYTES (sizeof(lr_data_t) - 1)
 
 /* `lr_owner_t` is a typedef for the `uintptr_t` type, which is an unsigned
  * integer type that is large enough to hold a pointer value. It is used to
  * store the owner or user associated with each element in the Linked Ring
  * buffer. The `lr_owner` macro is provided as a convenience for casting a
  * pointer to the `lr_owner_t` type. */
-#define lr_owner_t uintptr_t
+#if !defined(LR_CELL_DATA_BITS)
+    #define lr_owner_t uintptr_t
+#else
+    /* Owner is stored in the data of the owner cell */
+    #define lr_owner_t lr_data_t
+#endif
 /* This macro is useful for ensuring that the owner is stored as an unsigned
  * integer, rather than a pointer, which may be necessary for certain operations
  * on the owner. The `lr_owner_t` type can be used to store either a pointer or
@@ -29,7 +141,7 @@
  * user, which could be represented by either a pointer or an enumerator value.
  * This can be useful for organizing and controlling access to the elements in
  * the buffer, depending on the specific needs of the application. */
-#define lr_owner(ptr) (uintptr_t) ptr
+#define lr_owner(ptr) (lr_owner_t) (uintptr_t) ptr
 
 
 typedef enum lr_result {
@@ -40,56 +152,422 @@ typedef enum lr_result {
     LR_ERROR_UNLOCK,
     LR_ERROR_BUFFER_FULL,
     LR_ERROR_BUFFER_EMPTY,
-    LR_ERROR_BUFFER_BUSY
+    LR_ERROR_BUFFER_BUSY,
+    LR_ERROR_TIMEOUT
 } lr_result_t;
 
+/* Policy of lr_put() on the full ring, see `lr_set_overflow()` */
+enum lr_overflow {
+    LR_OVERFLOW_FAIL = 0, // The element isn't added, LR_ERROR_BUFFER_FULL
+    LR_OVERFLOW_OWNER,    // The oldest element of the owner is dropped, or
+                          // of other owners in turn if the owner is new
+    LR_OVERFLOW_RING,     // The oldest element of owners in turn is dropped
+    LR_OVERFLOW_LONGEST   // The oldest element of the owner with the most
+                          // elements is dropped, needs the owner index
+};
+
 
 /* Representation of an element in the Linked Ring buffer */
 struct lr_cell {
+#if defined(LR_CELL_TIME)
+    lr_time_t       time;  // Time the element was added, first so data and
+                           // link don't pad around it
+#endif
+#if !defined(LR_CELL_SOA)
     lr_data_t       data;  // The data for the element.
+#endif
+#if defined(LR_CELL_INDEX_BITS)
+    lr_index_t      next;  // Index of the next element in the cells array,
+                           // LR_CELL_NIL if there is no next element.
+#else
     struct lr_cell *next;  // A pointer to the next element in the Linked Ring
                            // buffer. It allows the elements to be linked
                            // together in a circular fashion.
+#endif
+} LR_CELL_PACKED;
+
+/* Lock word of the owner locks, see `lr_set_owner_locks()` */
+#define lr_lock_t unsigned int
+
+/* Slot of the optional owner index. The index is an open-addressing hash
+ * table that maps owner to its owner cell, so owner lookup doesn't depend on
+ * number of owners stored in the buffer. Storage is supplied by the caller
+ * with `lr_set_index()`. */
+struct lr_owner_slot {
+    lr_owner_t      owner; // Owner stored in the slot
+    struct lr_cell *cell;  // Owner cell, NULL if slot is empty
+    size_t          count; // Number of elements of the owner
+    size_t          heap;  // Position of the owner in the heap of owners by
+                           // number of elements, see LR_OVERFLOW_LONGEST
+    lr_owner_t      heap_owner; // Owner at the position of the slot in the
+                                // heap, it isn't moved with the slot
+};
+
+/* Quota and watermarks of the owner. Quotas are stored in open-addressing
+ * hash table supplied by the caller with `lr_set_quotas()`. */
+struct lr_owner_quota {
+    lr_owner_t owner; // Owner of the quota
+    size_t     max;   // Elements of the owner at most, 0 if not limited
+    size_t     min;   // Elements reserved for the owner
+    size_t     high;  // High watermark, 0 if not set, the slot is empty if
+                      // it's not set and both limits are 0
+    size_t     low;   // Low watermark
+    int        above; // Owner reached the high watermark and didn't drop to
+                      // the low one yet
+#if defined(LR_CELL_TIME)
+    lr_time_t  ttl;   // Elements of the owner expire after it, 0 to use
+                      // TTL of the ring
+#endif
+    size_t     count; // Number of elements of the owner
+};
+
+/* Crossing of the watermark passed to the callback of
+ * `lr_set_watermark_callback()` */
+enum lr_watermark {
+    LR_WATERMARK_HIGH,      // The owner reached its high watermark
+    LR_WATERMARK_LOW,       // The owner dropped to its low watermark
+    LR_WATERMARK_RING_HIGH, // The ring reached its high watermark
+    LR_WATERMARK_RING_LOW   // The ring dropped to its low watermark
+};
+
+#if defined(LR_EVENTFD)
+/* Binding of the owner to the eventfd. Bindings are stored in open-addressing
+ * hash table supplied by the caller with `lr_set_events()`. */
+struct lr_owner_event {
+    lr_owner_t owner; // Owner bound to the eventfd
+    int        fd;    // Eventfd, -1 if the slot is empty
+};
+#endif
+
+/* Slot of flat combining, where the thread publishes its lr_put() or lr_get()
+ * request for the combiner. Slots are supplied by the caller with
+ * `lr_set_combining()`, each one takes its own cache line. */
+struct lr_combine_slot {
+    lr_lock_t   state;  // Free, claimed, pending or done
+    lr_lock_t   op;     // Put or get
+    lr_owner_t  owner;  // Owner of the element
+    lr_data_t   data;   // Data to put or the retrieved data
+    lr_result_t result; // Result of the applied request
+} __attribute__((aligned(64)));
+
+/* Thread holds up to LR_MCS_NODES MCS locks at once */
+#define LR_MCS_NODES 4
+
+struct lr_ticket_lock {
+    lr_lock_t next;    // Ticket of the next thread
+    lr_lock_t serving; // Ticket of the thread holding the lock
+};
+
+struct lr_mcs_node;
+struct lr_mcs_lock {
+    struct lr_mcs_node *tail; // Last queued thread, NULL if unlocked
+};
+
+struct lr_adaptive_lock {
+    lr_lock_t state; // 0 unlocked, 1 locked, 2 locked and someone sleeps
 };
 
+/* The lock of the ring is set with lr_set_mutex() at run time, which costs
+ * two indirect calls per operation. Define `LR_LOCK` as one of the values
+ * below (or set the `LR_LOCK` CMake option to NONE, SPIN, TICKET or ADAPTIVE)
+ * to fix it at build time instead: the lock object is kept in the ring and
+ * the lock is inlined in operations, while lr_set_mutex() and
+ * lr_set_owner_locks() refuse to set another one. NONE removes locking for
+ * single thread builds. */
+#define LR_LOCK_DYNAMIC  0
+#define LR_LOCK_NONE     1
+#define LR_LOCK_SPIN     2
+#define LR_LOCK_TICKET   3
+#define LR_LOCK_ADAPTIVE 4
+#if !defined(LR_LOCK)
+    #define LR_LOCK LR_LOCK_DYNAMIC
+#endif
+
 struct linked_ring {
     struct lr_cell *cells; // Allocated array of cellsin the buffer
+#if defined(LR_CELL_SOA)
+    lr_data_t *payload; // Data of the cells, parallel to the cells array
+#endif
     unsigned int    size;  // Maximum number of elements that can be stored
                            // Buffer size = size - N_owners
 
+#if defined(LR_POOL_LOCKFREE)
+    uint64_t        write; // Index of the first released cell in the low
+                           // half and the generation in the high half
+    lr_lock_t       taken; // Cells taken from the pool, which are not
+                           // linked or returned yet
+#if defined(LR_POOL_MAGAZINE)
+    lr_lock_t       cached; // Free cells in magazines of threads
+    unsigned int    epoch;  // Initialization of the ring, magazines of
+                            // previous ones are dropped
+#endif
+#else
     struct lr_cell *write; // Cell that is currently being written to
+#endif
+    unsigned int    reserve; // Number of free cells below the owners, which
+                             // aren't linked to the write position
+    struct lr_cell *pinned;       // Cell below the reserve, which was taken
+                                  // last from it and holds data
+    struct lr_cell *pinned_owner; // Owner of the pinned cell, NULL until the
+                                  // cell is appended to its chain
+    struct lr_cell *pinned_prev;  // Cell linked to the pinned one, when it
+                                  // was appended after other elements
+    int             borrowed; // Free cells borrowed from other rings with
+                              // lr_lend(), negative if lent to them
     struct lr_cell *owners; // Cell from which data about owners in buffer stored
                             // N_owners = cells + size - owners
+    size_t          count;  // Number of elements stored in the buffer
+
+    enum lr_overflow overflow;      // Policy of lr_put() on the full ring
+    size_t           overflow_next; // Turn of the owner to drop the element
+    size_t           dropped;       // Elements dropped on overflow
+    size_t           longest_nr;    // Owners in the heap of the index
+
+    struct lr_owner_quota *quotas;    // Optional quotas of owners
+    size_t                 quotas_nr; // Number of quota slots, power of two
+    size_t                 reserved;  // Cells reserved for owners below
+                                      // their minimum
 
-    enum lr_result (*lock)(void *state); // used to make operations thread-safe
-    enum lr_result (*unlock)(void *state);
+    size_t high;  // High watermark of elements in the ring, 0 if not set
+    size_t low;   // Low watermark of elements in the ring
+    int    above; // Ring reached the high watermark and didn't drop to the
+                  // low one yet
+    void (*watermark)(void *state, lr_owner_t owner,
+                      enum lr_watermark crossing); // Optional callback
+    void  *watermark_state;
+
+#if defined(LR_CELL_TIME)
+    lr_time_t ttl;         // Elements expire after it, 0 if they don't
+    size_t    ttls;        // Owners with own TTL in the table of quotas
+    size_t    expire_next; // Turn of the owner to check for expiry
+    size_t    expired;     // Elements dropped on expiry
+    lr_time_t (*clock)(void *state); // Time of added elements
+    void     *clock_state;
+#endif
+
+    struct lr_owner_slot *index;      // Optional hash index of owners
+    size_t                index_size; // Number of slots, power of two
+
+    enum lr_result (*lock)(void *state, lr_owner_t owner); // used to make operations thread-safe
+    enum lr_result (*unlock)(void *state, lr_owner_t owner);
 
     void *mutex_state;
+#if LR_LOCK == LR_LOCK_SPIN
+    lr_lock_t               mutex; // Lock of the ring fixed at build time
+#elif LR_LOCK == LR_LOCK_TICKET
+    struct lr_ticket_lock   mutex;
+#elif LR_LOCK == LR_LOCK_ADAPTIVE
+    struct lr_adaptive_lock mutex;
+#endif
+
+    // Optional locks of the links between chains
+    enum lr_result (*owner_lock)(void *state, size_t lock);
+    enum lr_result (*owner_unlock)(void *state, size_t lock);
+
+    void  *owner_locks_state;
+    size_t owner_locks_nr; // Number of owner locks, power of two
+    lr_lock_t  users;          // Operations sharing the ring with owner locks,
+                               // the highest bit is set by exclusive one
+    lr_lock_t  pool_lock;      // Lock of the free cells with owner locks
+
+    struct lr_combine_slot *combine_slots;    // Optional flat combining slots
+    size_t                  combine_slots_nr; // Number of slots, power of two
+    lr_lock_t               combine_lock;     // Lock of the combiner
+
+#if defined(LR_WAIT_FUTEX)
+    lr_lock_t *wait_words;    // Optional futex words of owners
+    size_t     wait_words_nr; // Number of wait words, power of two
+    lr_lock_t  space_word;    // Futex word of the free cells
+#endif
+
+#if defined(LR_EVENTFD)
+    struct lr_owner_event *events;    // Optional eventfds of owners
+    size_t                 events_nr; // Number of event slots, power of two
+    int                    data_fd;   // Eventfd of the non-empty ring, or -1
+    int                    space_fd;  // Eventfd of the not full ring, or -1
+#endif
 };
 
+struct lr_mutex_attr;
+
+/* Access to the next cell, which is NULL if the cell isn't linked */
+#if defined(LR_CELL_INDEX_BITS) && defined(LR_POOL_LOCKFREE)
+    #define lr_cell_next(lr, cell)                                             \
+        ({                                                                     \
+            lr_index_t next_ = __atomic_load_n(&(cell)->next, __ATOMIC_RELAXED); \
+            next_ == LR_CELL_NIL ? NULL : (lr)->cells + next_;                 \
+        })
+    #define lr_cell_link(lr, cell, next_cell)                                  \
+        __atomic_store_n(&(cell)->next,                                        \
+                         (next_cell) == NULL                                   \
+                             ? LR_CELL_NIL                                     \
+                             : (lr_index_t) ((next_cell) - (lr)->cells),       \
+                         __ATOMIC_RELAXED)
+#elif defined(LR_CELL_INDEX_BITS)
+    #define lr_cell_next(lr, cell)                                             \
+        ((cell)->next == LR_CELL_NIL ? NULL : (lr)->cells + (cell)->next)
+    #define lr_cell_link(lr, cell, next_cell)                                  \
+        ((cell)->next = (next_cell) == NULL                                    \
+                            ? LR_CELL_NIL                                      \
+                            : (lr_index_t) ((next_cell) - (lr)->cells))
+#elif defined(LR_POOL_LOCKFREE)
+    #define lr_cell_next(lr, cell) __atomic_load_n(&(cell)->next, __ATOMIC_RELAXED)
+    #define lr_cell_link(lr, cell, next_cell)                                  \
+        __atomic_store_n(&(cell)->next, (next_cell), __ATOMIC_RELAXED)
+#else
+    #define lr_cell_next(lr, cell)            ((cell)->next)
+    #define lr_cell_link(lr, cell, next_cell) ((cell)->next = (next_cell))
+#endif
+
+/* Access to the data of the cell */
+#if defined(LR_CELL_SOA)
+    #define lr_cell_data(lr, cell) ((lr)->payload[(cell) - (lr)->cells])
+#else
+    #define lr_cell_data(lr, cell) ((cell)->data)
+#endif
+
 
 size_t lr_count_limited_owned(struct linked_ring *, size_t limit,
                                 lr_owner_t owner);
 
 size_t lr_count(struct linked_ring *lr);
 
-#define lr_available(lr) ((lr)->size - lr_count(lr) - lr_owners_count(lr))
+#if defined(LR_POOL_LOCKFREE)
+/* Cells are counted as taken before the pop from the pool, so the sum could
+ * exceed the cells for a while and the result saturates at zero */
+#define lr_available(lr) ({                                                    \
+    size_t used_ = (lr)->count + lr_owners_count(lr)                           \
+                   + __atomic_load_n(&(lr)->taken, __ATOMIC_RELAXED);          \
+    size_t cells_ = (lr)->size + (lr)->borrowed;                               \
+    used_ < cells_ ? cells_ - used_ : 0;                                       \
+})
+#else
+#define lr_available(lr)                                                       \
+    ((lr)->size + (lr)->borrowed - (lr)->count - lr_owners_count(lr))
+#endif
 #define lr_size(lr) (lr->cells - lr->owners)
 #define lr_owners_count(lr) ((lr)->owners == NULL ? 0 : (lr)->cells + (lr)->size - (lr)->owners)
+/* Ring reached its high watermark and didn't drop to the low one yet */
+#define lr_above(lr) __atomic_load_n(&(lr)->above, __ATOMIC_RELAXED)
 #define lr_exists(lr, owner)      lr_count_limited_owned(lr, 1, owner)
 #define lr_count_owned(lr, owner) lr_count_limited_owned(lr, 0, owner)
+#define lr_clear_owner(lr, owner) lr_drain(lr, owner, NULL, NULL)
 
+#if defined(LR_CELL_SOA)
+lr_result_t lr_init_soa(struct linked_ring *lr, size_t size,
+                        struct lr_cell *cells, lr_data_t *payload);
+#else
 lr_result_t lr_init(struct linked_ring *lr, size_t size,
                     struct lr_cell *cells);
-void lr_set_mutex(struct linked_ring *lr, struct lr_mutex_attr *attr);
+#endif
+lr_result_t lr_set_index(struct linked_ring *lr, struct lr_owner_slot *slots,
+                         size_t slots_nr);
+lr_result_t lr_set_mutex(struct linked_ring *lr, struct lr_mutex_attr *attr);
+lr_result_t lr_set_owner_locks(struct linked_ring *lr, lr_lock_t *locks,
+                               size_t locks_nr);
+lr_result_t lr_set_combining(struct linked_ring *lr,
+                             struct lr_combine_slot *slots, size_t slots_nr);
+lr_result_t lr_set_overflow(struct linked_ring *lr, enum lr_overflow policy);
+lr_result_t lr_set_quotas(struct linked_ring *lr,
+                          struct lr_owner_quota *quotas, size_t quotas_nr);
+lr_result_t lr_set_quota(struct linked_ring *lr, lr_owner_t owner, size_t min,
+                         size_t max);
+lr_result_t lr_set_watermarks(struct linked_ring *lr, size_t low, size_t high);
+lr_result_t lr_set_owner_watermarks(struct linked_ring *lr, lr_owner_t owner,
+                                    size_t low, size_t high);
+lr_result_t lr_set_watermark_callback(
+    struct linked_ring *lr,
+    void (*watermark)(void *state, lr_owner_t owner, enum lr_watermark crossing),
+    void *state);
+int         lr_owner_above(struct linked_ring *lr, lr_owner_t owner);
+#if defined(LR_CELL_TIME)
+lr_result_t lr_set_clock(struct linked_ring *lr,
+                         lr_time_t (*clock)(void *state), void *state);
+lr_result_t lr_set_ttl(struct linked_ring *lr, lr_time_t ttl);
+lr_result_t lr_set_owner_ttl(struct linked_ring *lr, lr_owner_t owner,
+                             lr_time_t ttl);
+size_t      lr_expire(struct linked_ring *lr, lr_time_t now, size_t budget);
+lr_time_t   lr_clock_monotonic(void *state);
+#endif
 
 lr_result_t lr_get(struct linked_ring *, lr_data_t *, lr_owner_t requested_owner);
 lr_result_t lr_put(struct linked_ring *lr, lr_data_t data, lr_owner_t owner);
 lr_result_t lr_put_string(struct linked_ring *lr, unsigned char *data,
                            lr_owner_t owner);
+lr_result_t lr_put_bytes(struct linked_ring *lr, const unsigned char *buf,
+                         size_t len, lr_owner_t owner);
+size_t      lr_put_many(struct linked_ring *lr, const lr_data_t *src, size_t n,
+                        lr_owner_t owner);
+size_t      lr_get_many(struct linked_ring *lr, lr_data_t *dst, size_t max,
+                        lr_owner_t owner);
+size_t      lr_write(struct linked_ring *lr, const unsigned char *buf,
+                     size_t len, lr_owner_t owner);
+size_t      lr_read(struct linked_ring *lr, unsigned char *buf, size_t max,
+                    lr_owner_t owner);
+size_t      lr_drain(struct linked_ring *lr, lr_owner_t owner,
+                     void (*callback)(void *state, lr_data_t data),
+                     void *state);
 
 lr_result_t lr_get(struct linked_ring *, lr_data_t *, lr_owner_t requested_owner);
 
+#if defined(LR_EVENTFD)
+lr_result_t lr_set_events(struct linked_ring *lr,
+                          struct lr_owner_event *events, size_t events_nr);
+lr_result_t lr_bind_eventfd(struct linked_ring *lr, lr_owner_t owner, int fd);
+lr_result_t lr_set_eventfd(struct linked_ring *lr, int data_fd, int space_fd);
+#endif
+
+#if defined(LR_WAIT_FUTEX)
+lr_result_t lr_set_wait(struct linked_ring *lr, lr_lock_t *words,
+                        size_t words_nr);
+lr_result_t lr_get_wait(struct linked_ring *lr, lr_data_t *data,
+                        lr_owner_t owner, const struct timespec *timeout);
+lr_result_t lr_put_wait(struct linked_ring *lr, lr_data_t data,
+                        lr_owner_t owner, const struct timespec *timeout);
+#endif
+
+
+/* Sharded linked ring splits one array of cells between shards, linked rings
+ * with own segments and locks. Owners are hashed to shards, and the full
+ * shard borrows free cells of its neighbours with `lr_lend()`, so the cells
+ * are still shared by all owners. Cells of the last `owners_nr` positions of
+ * each shard are kept for its owner cells, a shard with more owners may fail
+ * to add new ones while its cells are lent. Cells are lent only when they are
+ * linked with pointers. */
+struct lr_sharded {
+    struct linked_ring *shards;    // Array of shards
+    size_t              shards_nr; // Number of shards, power of two
+    size_t              owners_nr; // Owner cells of each shard, not lent
+};
+
+/* Shard of the owner */
+#define lr_shard_nr(sr, owner) \
+    ((size_t) (((uint64_t) (owner) * 0x9E3779B97F4A7C15ULL) >> 32) & ((sr)->shards_nr - 1))
+#define lr_shard(sr, owner) (&(sr)->shards[lr_shard_nr(sr, owner)])
+
+#if defined(LR_CELL_SOA)
+lr_result_t lr_sharded_init_soa(struct lr_sharded *sr,
+                                struct linked_ring *shards, size_t shards_nr,
+                                size_t size, struct lr_cell *cells,
+                                lr_data_t *payload, size_t owners_nr);
+#else
+lr_result_t lr_sharded_init(struct lr_sharded *sr, struct linked_ring *shards,
+                            size_t shards_nr, size_t size,
+                            struct lr_cell *cells, size_t owners_nr);
+#endif
+lr_result_t lr_sharded_put(struct lr_sharded *sr, lr_data_t data,
+                           lr_owner_t owner);
+lr_result_t lr_sharded_get(struct lr_sharded *sr, lr_data_t *data,
+                           lr_owner_t owner);
+size_t      lr_sharded_count(struct lr_sharded *sr);
+size_t      lr_sharded_available(struct lr_sharded *sr);
+size_t      lr_lend(struct linked_ring *from, struct linked_ring *to,
+                    size_t nr, size_t keep);
+
+#if defined(LR_POOL_MAGAZINE)
+void lr_magazine_flush(struct linked_ring *lr);
+#endif
+
 
 /* Provides a mechanism for a thread to exclusively access the linked ring. 
 */
@@ -111,8 +589,76 @@ struct lr_mutex_attr
     */
     enum lr_result (*unlock)(void *state, lr_owner_t owner); 
 
+    /* Optional per-owner locks, which share the ring between owners like
+     * lr_set_owner_locks(). The owner locks are numbered from 0 to
+     * owner_locks_nr - 1, power of two, and the state keeps the lock objects.
+     * If set, lock and unlock are replaced by the lock of the whole ring.
+     * Fields of the attributes, which aren't used, should be zeroed.
+     */
+    size_t owner_locks_nr;
+    enum lr_result (*owner_lock)(void *state, size_t lock);
+    enum lr_result (*owner_unlock)(void *state, size_t lock);
 };
 
+/* Built-in locks, which are installed with lr_set_mutex(), so callbacks don't
+ * have to be written for common cases:
+ *
+ *   struct lr_ticket_lock ticket = {0};
+ *   lr_set_mutex(&lr, &LR_MUTEX_TICKET(&ticket));
+ *
+ * - Ticket lock serves threads in the order they came, so none of them starves.
+ * - MCS lock queues threads, each spins on its own node instead of the shared
+ *   word, which keeps the cache line of the lock quiet with many threads. A
+ *   thread holds up to LR_MCS_NODES MCS locks at once.
+ * - Adaptive mutex spins a while and then sleeps on the futex (yields the CPU
+ *   where futexes aren't available), so it suits more threads than cores.
+ * - Pthread wrapper uses pthread_mutex_t initialized by the caller.
+ *
+ * Ticket and adaptive locks can be owner locks too, with the array of
+ * owner_locks_nr lock objects as the state. Lock objects are zeroed before
+ * use. `LR_LOCK` fixes one of them as the lock of the ring at build time. */
+enum lr_result lr_ticket_lock(void *state, lr_owner_t owner);
+enum lr_result lr_ticket_unlock(void *state, lr_owner_t owner);
+enum lr_result lr_ticket_owner_lock(void *state, size_t lock);
+enum lr_result lr_ticket_owner_unlock(void *state, size_t lock);
+enum lr_result lr_mcs_lock(void *state, lr_owner_t owner);
+enum lr_result lr_mcs_unlock(void *state, lr_owner_t owner);
+enum lr_result lr_adaptive_lock(void *state, lr_owner_t owner);
+enum lr_result lr_adaptive_unlock(void *state, lr_owner_t owner);
+enum lr_result lr_adaptive_owner_lock(void *state, size_t lock);
+enum lr_result lr_adaptive_owner_unlock(void *state, size_t lock);
+#if defined(__unix__) || defined(__APPLE__)
+enum lr_result lr_pthread_lock(void *state, lr_owner_t owner);
+enum lr_result lr_pthread_unlock(void *state, lr_owner_t owner);
+#endif
+
+#define LR_MUTEX_TICKET(ticket)                                                \
+    ((struct lr_mutex_attr) {.state  = (ticket),                               \
+                             .lock   = lr_ticket_lock,                         \
+                             .unlock = lr_ticket_unlock})
+#define LR_MUTEX_MCS(mcs)                                                      \
+    ((struct lr_mutex_attr) {.state  = (mcs),                                  \
+                             .lock   = lr_mcs_lock,                            \
+                             .unlock = lr_mcs_unlock})
+#define LR_MUTEX_ADAPTIVE(adaptive)                                            \
+    ((struct lr_mutex_attr) {.state  = (adaptive),                             \
+                             .lock   = lr_adaptive_lock,                       \
+                             .unlock = lr_adaptive_unlock})
+#define LR_MUTEX_PTHREAD(mutex)                                                \
+    ((struct lr_mutex_attr) {.state  = (mutex),                                \
+                             .lock   = lr_pthread_lock,                        \
+                             .unlock = lr_pthread_unlock})
+#define LR_OWNER_MUTEX_TICKET(tickets, nr)                                     \
+    ((struct lr_mutex_attr) {.state          = (tickets),                      \
+                             .owner_locks_nr = (nr),                           \
+                             .owner_lock     = lr_ticket_owner_lock,           \
+                             .owner_unlock   = lr_ticket_owner_unlock})
+#define LR_OWNER_MUTEX_ADAPTIVE(adaptives, nr)                                 \
+    ((struct lr_mutex_attr) {.state          = (adaptives),                    \
+                             .owner_locks_nr = (nr),                           \
+                             .owner_lock     = lr_adaptive_owner_lock,         \
+                             .owner_unlock   = lr_adaptive_owner_unlock})
+
 
 /* not thread-safe */
 lr_result_t lr_dump(struct linked_ring *lr);
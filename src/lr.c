@@ -1,6 +1,72 @@
 #include "lr.h"
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#if defined(__unix__) || defined(__APPLE__)
+    #include <sched.h>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+    #include <pthread.h>
+#endif
+#if defined(__linux__)
+    #include <limits.h>
+    #include <linux/futex.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+#endif
+#if defined(LR_WAIT_FUTEX)
+    #include <errno.h>
+#endif
+#if defined(LR_EVENTFD)
+    #include <unistd.h>
+#endif
+#if defined(LR_CELL_TIME)
+    #include <time.h>
+#endif
+
+#if defined(LR_POOL_LOCKFREE)
+/* Top of the pool stack: index of the cell and the generation. The index is
+ * signed, cells lent by the ring below in the same array have negative ones,
+ * except -1, which is the owner cell of that ring and is never lent */
+#define LR_POOL_NIL 0xFFFFFFFFU
+#define lr_pool_top(lr, cell, generation) \
+    ((uint64_t) (generation) << 32 | ((cell) ? (uint32_t) ((cell) - (lr)->cells) : LR_POOL_NIL))
+#define lr_pool_cell(lr, top) \
+    ((uint32_t) (top) == LR_POOL_NIL ? NULL : (lr)->cells + (int32_t) (top))
+#define lr_pool_generation(top) ((uint32_t) ((top) >> 32))
+#endif
+
+#if defined(LR_POOL_MAGAZINE)
+/* Cells cached by the thread at most, and taken from the pool at once */
+#if !defined(LR_MAGAZINE_SIZE)
+    #define LR_MAGAZINE_SIZE 8
+#endif
+#define LR_MAGAZINE_BATCH (LR_MAGAZINE_SIZE / 2)
+
+/* Free cells cached by the thread */
+struct lr_magazine {
+    struct linked_ring *lr;    // Ring of the cached cells, NULL if empty
+    unsigned int        epoch; // Initialization of the ring
+    struct lr_cell     *cells; // Stack of cached cells
+    unsigned int        nr;    // Number of cached cells
+};
+
+static _Thread_local struct lr_magazine lr_magazine;
+static unsigned int   lr_epochs;
+static pthread_key_t  lr_magazine_key;
+static pthread_once_t lr_magazine_once = PTHREAD_ONCE_INIT;
+
+struct lr_cell* lr_magazine_pop(struct linked_ring *lr);
+void lr_magazine_push(struct linked_ring *lr, struct lr_cell *cell, size_t spare);
+
+/* Cells taken and released outside of the lock go through the magazine,
+ * spare is the number of other free cells seen by the releaser */
+#define lr_pool_take(lr)              lr_magazine_pop(lr)
+#define lr_pool_give(lr, cell, spare) lr_magazine_push(lr, cell, spare)
+#elif defined(LR_POOL_LOCKFREE)
+#define lr_pool_take(lr)              lr_pool_pop(lr)
+#define lr_pool_give(lr, cell, spare) ((void) (spare), lr_pool_push(lr, cell, cell))
+#endif
 
 /**
  * Initialize a new linked ring buffer.
@@ -8,457 +74,4533 @@
  * @param lr: pointer to the linked ring structure to be initialized
  * @param size: size of the buffer, in number of elements
  * @param cells: pointer to the array of cells that will make up the buffer
+ * @param payload: pointer to the array of data of the cells, if LR_CELL_SOA
+ *                 is defined
  * 
  * @return LR_OK: if the initialization was successful
- *         LR_ERROR_NOMEMORY: if the cells parameter is NULL or size is 0
+ *         LR_ERROR_NOMEMORY: if the cells parameter is NULL or size is 0, or
+ *                            size doesn't fit in the cell index
  */
+#if defined(LR_CELL_SOA)
+lr_result_t lr_init_soa(struct linked_ring *lr, size_t size,
+                        struct lr_cell *cells, lr_data_t *payload)
+#else
 lr_result_t lr_init(struct linked_ring *lr, size_t size,
                     struct lr_cell *cells)
+#endif
 {
     if (cells == NULL || size <= 0) {
         return LR_ERROR_NOMEMORY;
     }
 
+#if defined(LR_CELL_SOA)
+    if (payload == NULL) {
+        return LR_ERROR_NOMEMORY;
+    }
+    lr->payload = payload;
+#endif
+
+#if defined(LR_CELL_INDEX_BITS)
+    /* Every cell should have an index */
+    if (size >= LR_CELL_NIL) {
+        return LR_ERROR_NOMEMORY;
+    }
+#endif
+
     lr->cells = cells;
     lr->size   = size;
     lr->owners = NULL;
 
-    /* Set the write position to the first cell in the buffer */
-    lr->write = lr->cells;
+    /* All cells are in the reserve, released cells are linked at the
+     * write position */
+#if defined(LR_POOL_LOCKFREE)
+    lr->write   = LR_POOL_NIL;
+    lr->taken   = 0;
+#endif
+#if defined(LR_POOL_MAGAZINE)
+    lr->cached  = 0;
+    lr->epoch   = __atomic_add_fetch(&lr_epochs, 1, __ATOMIC_RELAXED);
+#endif
+#if defined(LR_POOL_LOCKFREE)
+#else
+    lr->write   = NULL;
+#endif
+    lr->reserve = size;
+    lr->pinned  = NULL;
+    lr->pinned_owner = NULL;
+    lr->pinned_prev  = NULL;
+    lr->borrowed = 0;
+    lr->count   = 0;
 
-    /* Initialize the cells */
-    /* Link the cells in a ring */
-    for (size_t idx = 0; idx < lr->size - 1; ++idx) {
-        lr->cells[idx].next = &lr->cells[idx + 1];  /* Every cell points to the next */
-    }
+    /* Use lr_set_overflow to drop oldest elements on the full ring */
+    lr->overflow      = LR_OVERFLOW_FAIL;
+    lr->overflow_next = 0;
+    lr->longest_nr    = 0;
+    lr->dropped       = 0;
+
+    /* Use lr_set_quotas and lr_set_quota to limit and reserve cells of
+     * owners */
+    lr->quotas    = NULL;
+    lr->quotas_nr = 0;
+    lr->reserved  = 0;
+
+    /* Use lr_set_watermarks, lr_set_owner_watermarks and
+     * lr_set_watermark_callback for backpressure */
+    lr->high            = 0;
+    lr->low             = 0;
+    lr->above           = 0;
+    lr->watermark       = NULL;
+    lr->watermark_state = NULL;
+
+#if defined(LR_CELL_TIME)
+    /* Use lr_set_ttl and lr_set_owner_ttl to expire elements */
+    lr->ttl         = 0;
+    lr->ttls        = 0;
+    lr->expire_next = 0;
+    lr->expired     = 0;
+    lr->clock       = lr_clock_monotonic;
+    lr->clock_state = NULL;
+#endif
+
+    /* Use lr_set_index to enable owner index */
+    lr->index      = NULL;
+    lr->index_size = 0;
 
     /* Use lr_set_mutex to initialize these fields */
     lr->lock = NULL;
     lr->unlock = NULL;
     lr->mutex_state = NULL;
+#if LR_LOCK != LR_LOCK_DYNAMIC && LR_LOCK != LR_LOCK_NONE
+    memset(&lr->mutex, 0, sizeof(lr->mutex));
+#endif
+
+    /* Use lr_set_owner_locks or lr_set_mutex to share the ring between
+     * owners */
+    lr->owner_lock        = NULL;
+    lr->owner_unlock      = NULL;
+    lr->owner_locks_state = NULL;
+    lr->owner_locks_nr    = 0;
+    lr->users             = 0;
+    lr->pool_lock         = 0;
+
+    /* Use lr_set_combining to combine lr_put and lr_get of threads */
+    lr->combine_slots    = NULL;
+    lr->combine_slots_nr = 0;
+    lr->combine_lock     = 0;
+
+#if defined(LR_WAIT_FUTEX)
+    /* Use lr_set_wait to block in lr_get_wait and lr_put_wait */
+    lr->wait_words    = NULL;
+    lr->wait_words_nr = 0;
+    lr->space_word    = 0;
+#endif
+
+#if defined(LR_EVENTFD)
+    /* Use lr_set_events, lr_bind_eventfd and lr_set_eventfd to signal event
+     * loops */
+    lr->events    = NULL;
+    lr->events_nr = 0;
+    lr->data_fd   = -1;
+    lr->space_fd  = -1;
+#endif
 
     return LR_OK;
 }
 
 #define lr_last_cell(lr) ((lr)->cells + (lr)->size - 1)
+/* Owner cell is linked to the last element of the owner */
+#define lr_owner_tail(lr, owner_cell) lr_cell_next(lr, owner_cell)
+/* Cell above the reserve, the lowest owner cell or the end of cells */
+#define lr_owners_base(lr) ((lr)->owners ? (lr)->owners : (lr)->cells + (lr)->size)
+
+/* Cell below the reserve holds data and its link is known */
+#define lr_pinned(lr) \
+    ((lr)->pinned_owner && (lr)->pinned == lr_owners_base(lr) - (lr)->reserve - 1)
+
+/* Lock and unlock of the ring: functions set by lr_set_mutex(), or the lock
+ * fixed by LR_LOCK, which takes the free lock inline and calls the function
+ * only to wait */
+void lr_spin_lock(lr_lock_t *lock);
+void lr_ticket_wait(struct lr_ticket_lock *ticket, lr_lock_t mine);
+
+#if LR_LOCK == LR_LOCK_DYNAMIC
+#define lr_mutex_lock(lr, owner) \
+    ((lr)->lock != NULL ? ((lr)->lock)((lr)->mutex_state, owner) : LR_OK)
+#define lr_mutex_unlock(lr, owner) \
+    ((lr)->unlock != NULL ? ((lr)->unlock)((lr)->mutex_state, owner) : LR_OK)
+#elif LR_LOCK == LR_LOCK_NONE
+#define lr_mutex_lock(lr, owner) ((void) (owner), LR_OK)
+#define lr_mutex_unlock(lr, owner) ((void) (owner), LR_OK)
+#elif LR_LOCK == LR_LOCK_SPIN
+#define lr_mutex_lock(lr, owner) ({ \
+    (void) (owner); \
+    if (__atomic_exchange_n(&(lr)->mutex, 1, __ATOMIC_ACQUIRE)) { \
+        lr_spin_lock(&(lr)->mutex); \
+    } \
+    LR_OK; \
+})
+#define lr_mutex_unlock(lr, owner) \
+    ((void) (owner), __atomic_store_n(&(lr)->mutex, 0, __ATOMIC_RELEASE), LR_OK)
+#elif LR_LOCK == LR_LOCK_TICKET
+#define lr_mutex_lock(lr, owner) ({ \
+    lr_lock_t mine_ = __atomic_fetch_add(&(lr)->mutex.next, 1, __ATOMIC_RELAXED); \
+    (void) (owner); \
+    if (__atomic_load_n(&(lr)->mutex.serving, __ATOMIC_ACQUIRE) != mine_) { \
+        lr_ticket_wait(&(lr)->mutex, mine_); \
+    } \
+    LR_OK; \
+})
+#define lr_mutex_unlock(lr, owner) \
+    ((void) (owner), \
+     __atomic_store_n(&(lr)->mutex.serving, \
+                      __atomic_load_n(&(lr)->mutex.serving, __ATOMIC_RELAXED) + 1, \
+                      __ATOMIC_RELEASE), \
+     LR_OK)
+#elif LR_LOCK == LR_LOCK_ADAPTIVE
+#define lr_mutex_lock(lr, owner) ({ \
+    lr_lock_t free_ = 0; \
+    if (!__atomic_compare_exchange_n(&(lr)->mutex.state, &free_, 1, 0, \
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) { \
+        lr_adaptive_lock(&(lr)->mutex, owner); \
+    } \
+    LR_OK; \
+})
+#define lr_mutex_unlock(lr, owner) ({ \
+    lr_lock_t free_ = 1; \
+    if (!__atomic_compare_exchange_n(&(lr)->mutex.state, &free_, 0, 0, \
+                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED)) { \
+        lr_adaptive_unlock(&(lr)->mutex, owner); \
+    } \
+    LR_OK; \
+})
+#else
+    #error "LR_LOCK should be LR_LOCK_NONE, LR_LOCK_SPIN, LR_LOCK_TICKET or LR_LOCK_ADAPTIVE"
+#endif
 
 /* Lock the mutex if lock function provided, no op otherwise */
-#define lock(lr) do { \
-    if (lr->lock != NULL) { \
-        enum lr_result ret = lr->lock(lr->mutex_state); \
-        if (ret != LR_OK) { \
-            return ret; \
+#define lock(lr, owner) do { \
+    enum lr_result ret = lr_mutex_lock(lr, owner); \
+    if (ret != LR_OK) { \
+        return ret; \
+    } \
+} while (0)
+
+/* Unlock the mutex if unlock function provided and then return ret  */
+#define unlock_and_return(lr, owner, ret) do { \
+    enum lr_result unlock_ret = lr_mutex_unlock(lr, owner); \
+    if (unlock_ret != LR_OK) { \
+        return unlock_ret; \
+    } \
+    return ret; \
+} while (0)
+
+/* Additional overload for returning success */
+#define unlock_and_succeed(lr, owner) unlock_and_return(lr, owner, LR_OK)
+
+#if defined(LR_POOL_LOCKFREE)
+/* Lock the mutex if lock function provided, the cell taken from the pool
+ * before is pushed back if it isn't locked */
+#define lock_or_release(lr, owner, cell) do { \
+    enum lr_result ret = lr_mutex_lock(lr, owner); \
+    if (ret != LR_OK) { \
+        if (cell != NULL) { \
+            lr_pool_give(lr, cell, 0); \
+            __atomic_sub_fetch(&lr->taken, 1, __ATOMIC_RELAXED); \
+            lr_wait_signal_space(lr); \
+            lr_event_space(lr, lr_available(lr) == 1); \
         } \
+        return ret; \
+    } \
+} while (0)
+
+/* Unlock the mutex, push the taken cell to the pool and then return ret */
+#define unlock_and_release(lr, owner, cell, full, ret) do { \
+    size_t spare_ = lr_available(lr); \
+    enum lr_result unlock_ret = lr_mutex_unlock(lr, owner); \
+    lr_pool_give(lr, cell, spare_); \
+    __atomic_sub_fetch(&lr->taken, 1, __ATOMIC_RELAXED); \
+    lr_wait_signal_space(lr); \
+    lr_event_space(lr, full); \
+    return unlock_ret != LR_OK ? unlock_ret : ret; \
+} while (0)
+#else
+#define lock_or_release(lr, owner, cell) lock(lr, owner)
+#endif
+
+/* Lock the mutex if lock function provided, return fail if it isn't locked */
+#define lock_or_return(lr, owner, fail) do { \
+    if (lr_mutex_lock(lr, owner) != LR_OK) { \
+        return fail; \
+    } \
+} while (0)
+
+/* Unlock the mutex and return the number of processed elements, which are
+ * processed even if unlock failed */
+#define unlock_and_count(lr, owner, count) do { \
+    (void) lr_mutex_unlock(lr, owner); \
+    return count; \
+} while (0)
+
+
+/* States of flat combining slots and requests in them */
+#define LR_COMBINE_FREE    0
+#define LR_COMBINE_CLAIMED 1
+#define LR_COMBINE_PENDING 2
+#define LR_COMBINE_DONE    3
+#define LR_COMBINE_PUT     1
+#define LR_COMBINE_GET     2
+
+/* Passes of the combiner over the slots, next ones pick up requests published
+ * during the previous while other threads are active */
+#define LR_COMBINE_PASSES 4
+
+/* Cells borrowed by the full shard from a neighbour at once */
+#define LR_SHARD_LEND 8
+
+/* Exclusive operation flag in the users of the ring */
+#define LR_USERS_EXCLUSIVE (1U << (sizeof(lr_lock_t) * 8 - 1))
+
+/* Busy waits yield the CPU after a number of spins, so the holder isn't
+ * starved when threads outnumber cores */
+#define LR_SPIN_LIMIT 64
+#if defined(__unix__) || defined(__APPLE__)
+    #define lr_spin_yield() sched_yield()
+#else
+    #define lr_spin_yield() do { } while (0)
+#endif
+#define lr_spin_relax(spins) do { \
+    if (++(spins) >= LR_SPIN_LIMIT) { \
+        (spins) = 0; \
+        lr_spin_yield(); \
+    } \
+} while (0)
+
+#if defined(__linux__)
+#define lr_futex_wait(word, value, timeout) \
+    syscall(SYS_futex, (word), FUTEX_WAIT_PRIVATE, (value), (timeout), NULL, 0)
+#define lr_futex_wake(word, nr) \
+    syscall(SYS_futex, (word), FUTEX_WAKE_PRIVATE, (nr), NULL, NULL, 0)
+#endif
+
+#if defined(LR_WAIT_FUTEX)
+/* Wait word counts changes, the highest bit is set when someone sleeps on it */
+#define LR_WAIT_PARKED (1U << (sizeof(lr_lock_t) * 8 - 1))
+
+/* Fibonacci hashing of the owner into the wait word */
+#define lr_wait_word(lr, owner) \
+    (&(lr)->wait_words[((uint64_t) (owner) * 0x9E3779B97F4A7C15ULL >> 32) & ((lr)->wait_words_nr - 1)])
+
+/* Wake waiters of the owner data */
+#define lr_wait_signal_owner(lr, owner) do { \
+    if ((lr)->wait_words != NULL) { \
+        lr_wait_signal(lr_wait_word(lr, owner)); \
+    } \
+} while (0)
+
+/* Wake waiters of free cells */
+#define lr_wait_signal_space(lr) do { \
+    if ((lr)->wait_words != NULL) { \
+        lr_wait_signal(&(lr)->space_word); \
+    } \
+} while (0)
+#else
+#define lr_wait_signal_owner(lr, owner) do { } while (0)
+#define lr_wait_signal_space(lr) do { } while (0)
+#endif
+
+#if defined(LR_EVENTFD)
+/* Fibonacci hashing of the owner into the event slot */
+#define lr_event_hash(lr, owner) \
+    ((size_t) (((uint64_t) (owner) * 0x9E3779B97F4A7C15ULL) >> 32) & ((lr)->events_nr - 1))
+
+/* Signal the eventfd of the ring, if it was full before cells were released */
+#define lr_event_space(lr, full) do { \
+    if ((full) && (lr)->space_fd >= 0) { \
+        lr_eventfd_signal((lr)->space_fd); \
     } \
 } while (0)
+#else
+#define lr_event_space(lr, full) do { (void) sizeof(full); } while (0)
+#endif
+
+/* The ring with the number of elements has no free cells */
+#if defined(LR_POOL_LOCKFREE)
+#define lr_full_count(lr, count) \
+    ((count) + lr_owners_count(lr) + __atomic_load_n(&(lr)->taken, __ATOMIC_RELAXED) >= (lr)->size + (lr)->borrowed)
+/* Free cells of the ring with the number of elements, which isn't full */
+#define lr_spare_count(lr, count) \
+    ((lr)->size + (lr)->borrowed - (count) - lr_owners_count(lr) - __atomic_load_n(&(lr)->taken, __ATOMIC_RELAXED))
+#else
+#define lr_full_count(lr, count) ((count) + lr_owners_count(lr) >= (lr)->size + (lr)->borrowed)
+#endif
+
+/* Number of the lock of the link from the tail of the owner to the next
+ * chain */
+#define lr_owner_lock_nr(lr, owner_cell) \
+    ((size_t) (lr_last_cell(lr) - (owner_cell)) & ((lr)->owner_locks_nr - 1))
+
+/* The tail of the owner is published with release ordering, so the data and
+ * links of appended cells are visible to the one who loads it with acquire */
+#if defined(LR_CELL_INDEX_BITS)
+    #define lr_owner_tail_acquire(lr, owner_cell) \
+        ((lr)->cells + __atomic_load_n(&(owner_cell)->next, __ATOMIC_ACQUIRE))
+    #define lr_owner_link_release(lr, owner_cell, tail) \
+        __atomic_store_n(&(owner_cell)->next, (lr_index_t) ((tail) - (lr)->cells), __ATOMIC_RELEASE)
+#else
+    #define lr_owner_tail_acquire(lr, owner_cell) \
+        __atomic_load_n(&(owner_cell)->next, __ATOMIC_ACQUIRE)
+    #define lr_owner_link_release(lr, owner_cell, tail) \
+        __atomic_store_n(&(owner_cell)->next, tail, __ATOMIC_RELEASE)
+#endif
+
+/* Time of added elements is kept in cells */
+#if defined(LR_CELL_TIME)
+    #define lr_now(lr)                   ((lr)->clock((lr)->clock_state))
+    #define lr_cell_stamp(lr, cell, now) ((cell)->time = (now))
+    #define lr_expiring(lr)              ((lr)->ttl || (lr)->ttls)
+#else
+    #define lr_cell_stamp(lr, cell, now)
+    #define lr_expiring(lr)              0
+#endif
+
+/* Packed bytes: number of bytes in the lowest byte of the data, then bytes */
+#define lr_bytes_fill(word) ((size_t) ((word) & 0xff))
+#define lr_bytes_byte(word, idx) ((unsigned char) ((word) >> (8 * ((idx) + 1))))
+#define lr_bytes_set(word, idx, byte) \
+    ((lr_data_t) ((word) | ((lr_data_t) (byte) << (8 * ((idx) + 1)))))
+#define lr_bytes_refill(word, fill) \
+    ((lr_data_t) (((word) & ~(lr_data_t) 0xff) | (fill)))
+/* Drop nr bytes from the beginning of the cell */
+#define lr_bytes_drop(word, nr) \
+    lr_bytes_refill((word) >> (8 * (nr)), lr_bytes_fill(word) - (nr))
+
+/* Fibonacci hashing of the owner into the index slot */
+#define lr_index_hash(lr, owner) \
+    ((size_t) (((uint64_t) (owner) * 0x9E3779B97F4A7C15ULL) >> 32) & ((lr)->index_size - 1))
+
+/**
+ * Find the index slot of the owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner to look up
+ *
+ * @return pointer to the slot holding the owner, NULL if owner isn't indexed
+ */
+struct lr_owner_slot* lr_index_find(struct linked_ring *lr, lr_owner_t owner) {
+    struct lr_owner_slot *slot;
+    size_t idx;
+
+    idx = lr_index_hash(lr, owner);
+    for (size_t probe = 0; probe < lr->index_size; probe++) {
+        slot = &lr->index[idx];
+        if (slot->cell == NULL) {
+            return NULL;
+        }
+        if (slot->owner == owner) {
+            return slot;
+        }
+        idx = (idx + 1) & (lr->index_size - 1);
+    }
+
+    return NULL;
+}
+
+/* Owners are kept in the heap by number of elements for LR_OVERFLOW_LONGEST */
+#define lr_longest(lr) ((lr)->overflow == LR_OVERFLOW_LONGEST && (lr)->index)
+#define lr_longest_count(lr, pos) \
+    (lr_index_find(lr, (lr)->index[pos].heap_owner)->count)
+
+/**
+ * Swap two owners in the heap of owners.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param a: position of the first owner
+ * @param b: position of the second owner
+ */
+void lr_longest_swap(struct linked_ring *lr, size_t a, size_t b) {
+    lr_owner_t owner;
+
+    owner                  = lr->index[a].heap_owner;
+    lr->index[a].heap_owner = lr->index[b].heap_owner;
+    lr->index[b].heap_owner = owner;
+
+    lr_index_find(lr, lr->index[a].heap_owner)->heap = a;
+    lr_index_find(lr, lr->index[b].heap_owner)->heap = b;
+}
+
+/**
+ * Restore the heap after number of elements of the owner at the position is
+ * changed. The owner with the most elements is at the top of the heap.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param pos: position of the owner in the heap
+ */
+void lr_longest_sift(struct linked_ring *lr, size_t pos) {
+    size_t parent;
+    size_t child;
+
+    while(pos > 0) {
+        parent = (pos - 1) / 2;
+        if(lr_longest_count(lr, parent) >= lr_longest_count(lr, pos)) {
+            break;
+        }
+        lr_longest_swap(lr, parent, pos);
+        pos = parent;
+    }
+
+    while((child = 2 * pos + 1) < lr->longest_nr) {
+        if(child + 1 < lr->longest_nr
+           && lr_longest_count(lr, child + 1) > lr_longest_count(lr, child)) {
+            child += 1;
+        }
+        if(lr_longest_count(lr, pos) >= lr_longest_count(lr, child)) {
+            break;
+        }
+        lr_longest_swap(lr, pos, child);
+        pos = child;
+    }
+}
+
+/**
+ * Add the owner of the slot to the heap of owners.
+ */
+void lr_longest_push(struct linked_ring *lr, struct lr_owner_slot *slot) {
+    size_t pos;
+
+    pos = lr->longest_nr++;
+    lr->index[pos].heap_owner = slot->owner;
+    slot->heap                = pos;
+    lr_longest_sift(lr, pos);
+}
+
+/**
+ * Remove the owner of the slot from the heap of owners, the last owner of
+ * the heap takes its position.
+ */
+void lr_longest_remove(struct linked_ring *lr, struct lr_owner_slot *slot) {
+    size_t pos;
+    size_t last;
+
+    pos  = slot->heap;
+    last = --lr->longest_nr;
+    if(pos == last) {
+        return;
+    }
+
+    lr->index[pos].heap_owner = lr->index[last].heap_owner;
+    lr_index_find(lr, lr->index[pos].heap_owner)->heap = pos;
+    lr_longest_sift(lr, pos);
+}
+
+/**
+ * Build the heap of owners from the index.
+ */
+void lr_longest_build(struct linked_ring *lr) {
+    lr->longest_nr = 0;
+    for (size_t idx = 0; idx < lr->index_size; idx++) {
+        if (lr->index[idx].cell) {
+            lr_longest_push(lr, &lr->index[idx]);
+        }
+    }
+}
+
+/**
+ * Insert or update the owner cell in the index. The caller guarantees that
+ * there is a free slot, i.e. number of owners is less than index size.
+ *
+ * @return pointer to the slot of the owner
+ */
+struct lr_owner_slot* lr_index_insert(struct linked_ring *lr, lr_owner_t owner, struct lr_cell *cell) {
+    struct lr_owner_slot *slot;
+    size_t idx;
+
+    idx = lr_index_hash(lr, owner);
+    for (size_t probe = 0; probe < lr->index_size; probe++) {
+        slot = &lr->index[idx];
+        if (slot->cell == NULL) {
+            /* New owner doesn't have elements yet */
+            slot->owner = owner;
+            slot->count = 0;
+            slot->cell  = cell;
+            if (lr_longest(lr)) {
+                lr_longest_push(lr, slot);
+            }
+        }
+        if (slot->owner == owner) {
+            slot->cell = cell;
+            return slot;
+        }
+        idx = (idx + 1) & (lr->index_size - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * Remove the owner from the index. Following slots of the probe sequence
+ * are shifted back, so the table never keeps tombstones.
+ */
+void lr_index_remove(struct linked_ring *lr, lr_owner_t owner) {
+    struct lr_owner_slot *hole;
+    struct lr_owner_slot *slot;
+    lr_owner_t heap_owner;
+    size_t mask;
+    size_t home;
+    size_t hole_idx;
+    size_t idx;
+
+    hole = lr_index_find(lr, owner);
+    if (hole == NULL) {
+        return;
+    }
+    if (lr_longest(lr)) {
+        lr_longest_remove(lr, hole);
+    }
+
+    mask     = lr->index_size - 1;
+    hole_idx = hole - lr->index;
+    idx      = hole_idx;
+    while (1) {
+        idx  = (idx + 1) & mask;
+        slot = &lr->index[idx];
+        if (slot->cell == NULL) {
+            break;
+        }
+
+        /* Move the slot into the hole if its home isn't between hole and slot */
+        home = lr_index_hash(lr, slot->owner);
+        if (((idx - home) & mask) >= ((idx - hole_idx) & mask)) {
+            /* Heap position stays with the slot */
+            heap_owner                     = lr->index[hole_idx].heap_owner;
+            lr->index[hole_idx]            = *slot;
+            lr->index[hole_idx].heap_owner = heap_owner;
+            hole_idx                       = idx;
+        }
+    }
+
+    lr->index[hole_idx].cell = NULL;
+}
+
+/**
+ * Find the owner cell.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner to look up
+ * @param slot: set to the index slot of the owner, NULL without index
+ *
+ * @return pointer to the owner cell, NULL if owner has no elements
+ */
+struct lr_cell* lr_owner_find(struct linked_ring *lr, lr_data_t owner, struct lr_owner_slot **slot) {
+    *slot = NULL;
+
+    /* Resolve the owner with the index if available */
+    if (lr->index) {
+        *slot = lr_index_find(lr, owner);
+
+        return *slot ? (*slot)->cell : NULL;
+    }
+
+    /* Traverse through each owner in the owner array */
+    for (struct lr_cell *owner_cell = lr->owners; owner_cell < lr->owners + lr_owners_count(lr); owner_cell++) {
+        /* Check if owner of the current cell matches with given owner */
+        if (lr_cell_data(lr, owner_cell) == owner) {
+            return owner_cell;
+        }
+    }
+
+    return NULL;
+}
+
+struct lr_cell* lr_owner_head(struct linked_ring *lr, struct lr_cell *owner_cell) {
+    struct lr_cell *head;
+    struct lr_cell *prev_owner;
+
+    if(owner_cell == lr_last_cell(lr)) {
+        /* If the provided owner is first, then last added owner is used 
+         * to link with owner_cell head 
+         */
+        head = lr_cell_next(lr, lr_owner_tail(lr, lr->owners));
+    } else {
+        /* For any other cell, the prev owner is used for head linkage */
+        prev_owner = owner_cell + 1;  /* Owners stored in reverse oreder */
+        head = lr_cell_next(lr, lr_owner_tail(lr, prev_owner));
+    }
+    
+    return head;
+}
+
+
+/**
+ * Pop the released cell from the pool. It's lock-free if LR_POOL_LOCKFREE is
+ * defined, the next cell read from the popped one could be stale only if the
+ * top was changed, and then the generation doesn't match.
+ *
+ * @param lr: pointer to the linked ring structure
+ *
+ * @return pointer to the cell, NULL if no cells are released
+ */
+struct lr_cell* lr_pool_pop(struct linked_ring *lr) {
+    struct lr_cell *cell;
+#if defined(LR_POOL_LOCKFREE)
+    uint64_t top;
+    uint64_t next;
+
+    top = __atomic_load_n(&lr->write, __ATOMIC_ACQUIRE);
+    do {
+        cell = lr_pool_cell(lr, top);
+        if(cell == NULL) {
+            return NULL;
+        }
+        next = lr_pool_top(lr, lr_cell_next(lr, cell), lr_pool_generation(top) + 1);
+    } while(!__atomic_compare_exchange_n(&lr->write, &top, next, 1,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+#else
+    cell = lr->write;
+    if(cell) {
+        lr->write = lr_cell_next(lr, cell);
+    }
+#endif
+
+    return cell;
+}
+
+/**
+ * Push the chain of cells to the pool.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param first: pointer to the first cell of the chain
+ * @param last: pointer to the last cell of the chain
+ */
+void lr_pool_push(struct linked_ring *lr, struct lr_cell *first, struct lr_cell *last) {
+#if defined(LR_POOL_LOCKFREE)
+    uint64_t top;
+
+    top = __atomic_load_n(&lr->write, __ATOMIC_RELAXED);
+    do {
+        lr_cell_link(lr, last, lr_pool_cell(lr, top));
+    } while(!__atomic_compare_exchange_n(&lr->write, &top,
+                                         lr_pool_top(lr, first, lr_pool_generation(top) + 1), 1,
+                                         __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+#else
+    lr_cell_link(lr, last, lr->write);
+    lr->write = first;
+#endif
+}
+
+/**
+ * Remove the cell from the pool. The whole pool is taken to look it up, and
+ * the rest is pushed back.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param cell: pointer to the cell to be removed
+ *
+ * @return 1 if the cell was removed, 0 if it isn't in the pool
+ */
+int lr_pool_remove(struct linked_ring *lr, struct lr_cell *cell) {
+    struct lr_cell *first;
+    struct lr_cell *needle;
+    int found;
+#if defined(LR_POOL_LOCKFREE)
+    uint64_t top;
+
+#if defined(LR_POOL_MAGAZINE)
+    /* Cell could be cached by the thread, cells of other threads are
+     * out of reach */
+    lr_magazine_flush(lr);
+#endif
+
+    top = __atomic_load_n(&lr->write, __ATOMIC_ACQUIRE);
+    while(!__atomic_compare_exchange_n(&lr->write, &top,
+                                       lr_pool_top(lr, (struct lr_cell *) NULL, lr_pool_generation(top) + 1), 1,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+    }
+    first = lr_pool_cell(lr, top);
+#else
+    first = lr->write;
+    lr->write = NULL;
+#endif
+
+    found = 0;
+    if(first == cell) {
+        first = lr_cell_next(lr, cell);
+        found = 1;
+    }
+
+    for(needle = first; needle && !found; needle = lr_cell_next(lr, needle)) {
+        if(lr_cell_next(lr, needle) == cell) {
+            lr_cell_link(lr, needle, lr_cell_next(lr, cell));
+            found = 1;
+        }
+    }
+
+    if(first) {
+        for(needle = first; lr_cell_next(lr, needle); needle = lr_cell_next(lr, needle)) {
+        }
+        lr_pool_push(lr, first, needle);
+    }
+
+    return found;
+}
+
+#if defined(LR_POOL_MAGAZINE)
+/**
+ * Take the chain of up to nr cells from the lock-free pool at once.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param nr: maximum number of cells
+ * @param popped: pointer to the number of taken cells
+ *
+ * @return pointer to the first cell of the chain, NULL if the pool is empty
+ */
+struct lr_cell* lr_pool_pop_many(struct linked_ring *lr, unsigned int nr,
+                                 unsigned int *popped) {
+    struct lr_cell *first;
+    struct lr_cell *last;
+    struct lr_cell *next;
+    unsigned int count;
+    uint64_t top;
+
+    top = __atomic_load_n(&lr->write, __ATOMIC_ACQUIRE);
+    do {
+        first = lr_pool_cell(lr, top);
+        if(first == NULL) {
+            return NULL;
+        }
+
+        /* Links of cells popped by others meanwhile are stale, but the
+         * generation of the top fails the exchange then */
+        last  = first;
+        count = 1;
+        while(count < nr && (next = lr_cell_next(lr, last)) != NULL) {
+            last = next;
+            count++;
+        }
+        next = lr_cell_next(lr, last);
+    } while(!__atomic_compare_exchange_n(&lr->write, &top,
+                                         lr_pool_top(lr, next, lr_pool_generation(top) + 1), 1,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE));
+
+    lr_cell_link(lr, last, (struct lr_cell *) NULL);
+    *popped = count;
+
+    return first;
+}
+
+/* Magazine is returned to its ring when the thread exits */
+void lr_magazine_exit(void *state)
+{
+    (void) state;
+
+    lr_magazine_flush(lr_magazine.lr);
+}
+
+void lr_magazine_key_create(void)
+{
+    pthread_key_create(&lr_magazine_key, lr_magazine_exit);
+}
+
+/**
+ * Return cells cached by the thread to the pool of the ring. Cells cached
+ * for the ring before it was initialized again are dropped.
+ *
+ * @param lr: pointer to the linked ring structure
+ */
+void lr_magazine_flush(struct linked_ring *lr)
+{
+    struct lr_cell *last;
+
+    if(lr == NULL || lr_magazine.lr != lr) {
+        return;
+    }
+
+    if(lr_magazine.cells != NULL && lr_magazine.epoch == lr->epoch) {
+        for(last = lr_magazine.cells; lr_cell_next(lr, last); last = lr_cell_next(lr, last)) {
+        }
+        lr_pool_push(lr, lr_magazine.cells, last);
+        __atomic_sub_fetch(&lr->cached, lr_magazine.nr, __ATOMIC_RELAXED);
+        lr_wait_signal_space(lr);
+    }
+
+    lr_magazine.lr    = NULL;
+    lr_magazine.cells = NULL;
+    lr_magazine.nr    = 0;
+}
+
+/**
+ * Bind the magazine of the thread to the ring, cells of other ring are
+ * returned to it.
+ *
+ * @param lr: pointer to the linked ring structure
+ */
+void lr_magazine_bind(struct linked_ring *lr)
+{
+    if(lr_magazine.lr == lr && lr_magazine.epoch == lr->epoch) {
+        return;
+    }
+
+    lr_magazine_flush(lr_magazine.lr);
+
+    pthread_once(&lr_magazine_once, lr_magazine_key_create);
+    pthread_setspecific(lr_magazine_key, &lr_magazine);
+
+    lr_magazine.lr    = lr;
+    lr_magazine.epoch = lr->epoch;
+}
+
+/**
+ * Take a free cell from the magazine of the thread, which is refilled from
+ * the pool when it's empty.
+ *
+ * @param lr: pointer to the linked ring structure
+ *
+ * @return pointer to the cell, NULL if the pool is empty
+ */
+struct lr_cell* lr_magazine_pop(struct linked_ring *lr)
+{
+    struct lr_cell *cell;
+    unsigned int popped;
+
+    lr_magazine_bind(lr);
+
+    if(lr_magazine.cells == NULL) {
+        cell = lr_pool_pop_many(lr, LR_MAGAZINE_BATCH, &popped);
+        if(cell == NULL) {
+            return NULL;
+        }
+
+        lr_magazine.cells = lr_cell_next(lr, cell);
+        lr_magazine.nr    = popped - 1;
+        __atomic_add_fetch(&lr->cached, popped - 1, __ATOMIC_RELAXED);
+
+        return cell;
+    }
+
+    cell = lr_magazine.cells;
+    lr_magazine.cells = lr_cell_next(lr, cell);
+    lr_magazine.nr--;
+    __atomic_sub_fetch(&lr->cached, 1, __ATOMIC_RELAXED);
+
+    return cell;
+}
+
+/**
+ * Cache the released cell in the magazine of the thread. If the magazine is
+ * full, or magazines hold half of free cells, the cell is pushed to the pool
+ * with the whole magazine, so cells aren't kept from threads waiting for
+ * them.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param cell: pointer to the released cell
+ * @param spare: number of other free cells seen under the lock
+ */
+void lr_magazine_push(struct linked_ring *lr, struct lr_cell *cell, size_t spare)
+{
+    struct lr_cell *last;
+
+    lr_magazine_bind(lr);
+
+    if(lr_magazine.nr < LR_MAGAZINE_SIZE
+       && __atomic_load_n(&lr->cached, __ATOMIC_RELAXED) * 2 < spare) {
+        lr_cell_link(lr, cell, lr_magazine.cells);
+        lr_magazine.cells = cell;
+        lr_magazine.nr++;
+        __atomic_add_fetch(&lr->cached, 1, __ATOMIC_RELAXED);
+
+        return;
+    }
+
+    last = cell;
+    if(lr_magazine.cells != NULL) {
+        for(last = lr_magazine.cells; lr_cell_next(lr, last); last = lr_cell_next(lr, last)) {
+        }
+        __atomic_sub_fetch(&lr->cached, lr_magazine.nr, __ATOMIC_RELAXED);
+    }
+    lr_cell_link(lr, cell, lr_magazine.cells);
+    lr_pool_push(lr, cell, last);
+
+    lr_magazine.cells = NULL;
+    lr_magazine.nr    = 0;
+}
+#endif
+
+/**
+ * Take a free cell from the pool. Released cells are linked at the write
+ * position, the reserve is used when they are exhausted.
+ *
+ * @param lr: pointer to the linked ring structure
+ *
+ * @return pointer to the free cell, NULL if the buffer is full
+ */
+struct lr_cell* lr_cell_alloc(struct linked_ring *lr) {
+    struct lr_cell *cell;
+
+#if defined(LR_POOL_MAGAZINE)
+    cell = lr_magazine_pop(lr);
+#else
+    cell = lr_pool_pop(lr);
+#endif
+    if(cell) {
+        return cell;
+    }
+
+    if(lr->reserve) {
+        cell = lr_owners_base(lr) - lr->reserve;
+        lr->reserve -= 1;
+
+        /* The cell is pinned, when it's appended to the chain */
+        lr->pinned       = cell;
+        lr->pinned_owner = NULL;
+
+        return cell;
+    }
+
+    return NULL;
+}
+
+/**
+ * Extend the reserve with the cell, if it adjoins the reserve. So cells
+ * released near the owner cells are kept for new owners.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param cell: pointer to the released cell
+ *
+ * @return 1 if the cell is in the reserve now, 0 otherwise
+ */
+int lr_cell_reserve(struct linked_ring *lr, struct lr_cell *cell) {
+    if(cell == lr_owners_base(lr) - lr->reserve - 1) {
+        lr->reserve += 1;
+
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Return the cell to the reserve or to the pool.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param cell: pointer to the cell to be released
+ */
+void lr_cell_release(struct linked_ring *lr, struct lr_cell *cell) {
+    if(lr_cell_reserve(lr, cell)) {
+        return;
+    }
+
+    lr_pool_push(lr, cell, cell);
+}
+
+/**
+ * Move the cell following the provided one to a free cell.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * @param prev: pointer to the cell linked to the cell to be moved
+ * @param owner_cell: pointer to the owner of the chain with the cell
+ * 
+ * @return pointer to the cell which stores the data now, NULL if there are
+ *         no free cells
+ */
+struct lr_cell* lr_cell_swap(struct linked_ring *lr, struct lr_cell *prev, struct lr_cell *owner_cell) {
+    struct lr_cell *cell;
+    struct lr_cell *swap;
+
+    cell = lr_cell_next(lr, prev);
+    swap = lr_cell_alloc(lr);
+    if(swap == NULL) {
+        /* Free cells are taken from the lock-free pool by others */
+        return NULL;
+    }
+
+    /* Copy the data and next pointer from the provided cell to the swap cell */
+    lr_cell_data(lr, swap) = lr_cell_data(lr, cell);
+    lr_cell_stamp(lr, swap, cell->time);
+    if(lr_cell_next(lr, cell) == cell) {
+        /* The only cell in the ring is linked to itself */
+        lr_cell_link(lr, swap, swap);
+    } else {
+        lr_cell_link(lr, swap, lr_cell_next(lr, cell));
+        lr_cell_link(lr, prev, swap);
+    }
+
+    /* Only the owner of the chain could point to the cell as a tail */
+    if(lr_owner_tail(lr, owner_cell) == cell) {
+        lr_cell_link(lr, owner_cell, swap);
+    }
+
+    return swap;
+}
+
+/* Lookup a cell in the linked ring buffer. Chains are walked in the ring
+ * order of their owners, so the previous cell and the owner of the cell are
+ * known when it's found. The found cell is moved to a free cell.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * @param cell: pointer to the cell to be looked up
+ * 
+ * @return pointer to the looked up cell if found, NULL otherwise
+ */
+struct lr_cell* lr_cell_lookup(struct linked_ring *lr, struct lr_cell *cell) {
+    struct lr_cell *owner_cell;
+    struct lr_cell *needle;
+    struct lr_cell *prev;
+    struct lr_cell *tail;
+    struct lr_cell *swap;
+
+    if(lr->owners == NULL)
+        return NULL;
+
+    /* The chain of the first owner follows the chain of the last one */
+    prev = lr_owner_tail(lr, lr->owners);
+    for(owner_cell = lr_last_cell(lr); owner_cell >= lr->owners; owner_cell--) {
+        tail = lr_owner_tail(lr, owner_cell);
+        needle = lr_cell_next(lr, prev);
+        while(needle != cell && needle != tail) {
+            prev = needle;
+            needle = lr_cell_next(lr, needle);
+        }
+
+        if(needle == cell) {
+            swap = lr_cell_swap(lr, prev, owner_cell);
+            if(swap && lr->pinned_prev == cell) {
+                /* The pinned cell is linked to the moved element */
+                lr->pinned_prev = swap;
+            }
+
+            return swap ? cell : NULL;
+        }
+
+        prev = tail;
+    }
+
+    return NULL;
+}
+
+/**
+ * Cell linked to the pinned cell. Elements are removed from the head of the
+ * chain and added after its tail, so the link to the cell appended after
+ * other elements doesn't change until the cell becomes the head.
+ *
+ * @param lr: pointer to the linked ring structure
+ *
+ * @return pointer to the cell linked to the pinned cell
+ */
+struct lr_cell* lr_pinned_prev(struct linked_ring *lr) {
+    struct lr_cell *prev_owner;
+    struct lr_cell *prev_tail;
+
+    if(lr->pinned_owner == lr_last_cell(lr)) {
+        prev_owner = lr->owners;
+    } else {
+        prev_owner = lr->pinned_owner + 1;
+    }
+    prev_tail = lr_owner_tail(lr, prev_owner);
+    if(lr_cell_next(lr, prev_tail) == lr->pinned) {
+        return prev_tail;
+    }
+
+    return lr->pinned_prev;
+}
+
+/**
+ * Allocate the cell for a new owner. Owner cells are stored in reverse order
+ * from the last cell, so the cell below the owners is used. Usually it's in
+ * the reserve. Data cells are taken from the bottom of the reserve, when no
+ * released cells are left, so the reserve is exhausted while the cell holds
+ * the element added with the last free cell. Its link is remembered, when
+ * it's appended, so the element is moved to a free cell without looking it
+ * up in the ring. Otherwise the cell is unlinked from the free pool or its
+ * data is moved to a free cell. The caller guarantees that two cells are free.
+ *
+ * @param lr: pointer to the linked ring structure
+ *
+ * @return pointer to the owner cell, NULL if it couldn't be allocated
+ */
+struct lr_cell* lr_owner_allocate(struct linked_ring *lr) {
+    struct lr_cell *owner_cell;
+
+    /* Allocate the owner cell at the appropriate position in the cells array */
+    owner_cell = lr_owners_base(lr) - 1;
+
+    if(lr->reserve == 0) {
+        if(lr_pinned(lr)) {
+            if(lr_cell_swap(lr, lr_pinned_prev(lr), lr->pinned_owner) == NULL) {
+                return NULL;
+            }
+        } else if(lr_pool_remove(lr, owner_cell) == 0
+                  && lr_cell_lookup(lr, owner_cell) == NULL) {
+            /* Cells are taken from the lock-free pool by others */
+            return NULL;
+        }
+        lr->reserve += 1;
+    }
+
+    /* The reserve ends with the owner cell */
+    lr->reserve -= 1;
+
+    return owner_cell;
+}
+
+/**
+ * Release the owner cell whose chain became empty. The last added owner is
+ * moved into the released slot, so retirement doesn't depend on the number
+ * of owners. Chains are ordered in the ring the same way as owner cells, so
+ * the chain of the moved owner is relinked between the chains of its new
+ * neighbours.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell with empty chain
+ */
+void lr_owner_retire(struct linked_ring *lr, struct lr_cell *owner_cell) {
+    struct lr_cell *last_owner;
+    struct lr_cell *last_tail;
+    struct lr_cell *last_head;
+    struct lr_cell *prev_tail;
+
+    if(lr->index)
+        lr_index_remove(lr, lr_cell_data(lr, owner_cell));
+
+    /* The pinned cell of the owner is released with its chain */
+    last_owner = lr->owners;
+    if(lr->pinned_owner == owner_cell) {
+        lr->pinned_owner = NULL;
+    } else if(lr->pinned_owner == last_owner) {
+        lr->pinned_owner = owner_cell;
+    }
+    if(owner_cell != last_owner) {
+        /* The chain of the last owner is followed by the chain of the first
+         * owner, so it's in place when the first or previous to the last
+         * owner is released */
+        if(owner_cell != lr_last_cell(lr) && owner_cell != last_owner + 1) {
+            last_tail = lr_owner_tail(lr, last_owner);
+            last_head = lr_cell_next(lr, lr_owner_tail(lr, last_owner + 1));
+
+            /* Unlink the chain from the end of the ring */
+            lr_cell_link(lr, lr_owner_tail(lr, last_owner + 1), lr_cell_next(lr, last_tail));
+
+            /* Link the chain after the chain of the previous owner */
+            prev_tail = lr_owner_tail(lr, owner_cell + 1);
+            lr_cell_link(lr, last_tail, lr_cell_next(lr, prev_tail));
+            lr_cell_link(lr, prev_tail, last_head);
+        }
+
+        lr_cell_link(lr, owner_cell, lr_owner_tail(lr, last_owner));
+        lr_cell_data(lr, owner_cell) = lr_cell_data(lr, last_owner);
+        if(lr->index)
+            lr_index_insert(lr, lr_cell_data(lr, owner_cell), owner_cell);
+    }
+
+    /* The slot of the last owner adjoins the reserve */
+    if(last_owner == lr_last_cell(lr)) {
+        lr->owners = NULL;
+    } else {
+        lr->owners += 1;
+    }
+    lr->reserve += 1;
+}
+
+/**
+ * Retire the owner, which was created by the operation that failed to
+ * allocate its data cells, so the owner without a chain isn't left.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell
+ */
+void lr_owner_abandon(struct linked_ring *lr, struct lr_cell *owner_cell) {
+    if(lr_owner_tail(lr, owner_cell) == NULL) {
+        lr_owner_retire(lr, owner_cell);
+    }
+}
+
+#define lr_quota_hash(lr, owner) \
+    ((size_t) (((uint64_t) (owner) * 0x9E3779B97F4A7C15ULL) >> 32) & ((lr)->quotas_nr - 1))
+#if defined(LR_CELL_TIME)
+    #define lr_quota_empty(quota) \
+        ((quota)->max == 0 && (quota)->min == 0 && (quota)->high == 0 && (quota)->ttl == 0)
+#else
+    #define lr_quota_empty(quota) ((quota)->max == 0 && (quota)->min == 0 && (quota)->high == 0)
+#endif
+
+/* Cells reserved for the owner below its minimum, the owner without elements
+ * needs its owner cell as well */
+#define lr_quota_unmet(quota) \
+    ((quota)->count < (quota)->min ? (quota)->min - (quota)->count + ((quota)->count == 0) : 0)
+
+/* Elements are counted for quotas, watermarks and the heap of owners, and
+ * expired under the mutex */
+#if LR_LOCK == LR_LOCK_DYNAMIC
+#define lr_counted(lr) ((lr)->quotas || (lr)->high || lr_longest(lr) || lr_expiring(lr))
+#else
+/* Quotas, overflow and TTL are refused with the lock fixed at build time */
+#define lr_counted(lr) ((lr)->high)
+#endif
+
+/* Count elements added to or removed from the owner */
+#define lr_count_add(lr, owner, nr) do { \
+    if (lr_counted(lr)) \
+        lr_count_update(lr, owner, (long) (nr)); \
+} while (0)
+#define lr_count_sub(lr, owner, nr) do { \
+    if (lr_counted(lr)) \
+        lr_count_update(lr, owner, -(long) (nr)); \
+} while (0)
+
+/* Report the crossing of the watermark to the callback */
+#define lr_watermark_cross(lr, owner, crossing) do { \
+    if ((lr)->watermark) \
+        (lr)->watermark((lr)->watermark_state, owner, crossing); \
+} while (0)
+
+/**
+ * Find the quota slot of the owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner to look up
+ *
+ * @return pointer to the slot of the owner, or to the empty slot where it
+ *         should be inserted, NULL if the table is full
+ */
+struct lr_owner_quota* lr_quota_find(struct linked_ring *lr, lr_owner_t owner) {
+    struct lr_owner_quota *quota;
+    size_t idx;
+
+    idx = lr_quota_hash(lr, owner);
+    for (size_t probe = 0; probe < lr->quotas_nr; probe++) {
+        quota = &lr->quotas[idx];
+        if (lr_quota_empty(quota) || quota->owner == owner) {
+            return quota;
+        }
+        idx = (idx + 1) & (lr->quotas_nr - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * Update the number of elements of the owner with the quota, the cells
+ * reserved for owners below their minimum, and check watermarks of the owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ * @param delta: number of added elements, negative if they're removed
+ */
+void lr_quota_count(struct linked_ring *lr, lr_owner_t owner, long delta) {
+    struct lr_owner_quota *quota;
+
+    quota = lr_quota_find(lr, owner);
+    if(quota == NULL || lr_quota_empty(quota)) {
+        return;
+    }
+
+    lr->reserved -= lr_quota_unmet(quota);
+    quota->count += delta;
+    lr->reserved += lr_quota_unmet(quota);
+
+    if(quota->high == 0) {
+        return;
+    }
+    if(!quota->above && quota->count >= quota->high) {
+        __atomic_store_n(&quota->above, 1, __ATOMIC_RELAXED);
+        lr_watermark_cross(lr, owner, LR_WATERMARK_HIGH);
+    } else if(quota->above && quota->count <= quota->low) {
+        __atomic_store_n(&quota->above, 0, __ATOMIC_RELAXED);
+        lr_watermark_cross(lr, owner, LR_WATERMARK_LOW);
+    }
+}
+
+/**
+ * Count elements added to or removed from the owner, after the number of
+ * elements in the ring and in the slot of the owner is changed. The owner is
+ * moved in the heap of owners, and watermarks of the ring are checked as
+ * well.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ * @param delta: number of added elements, negative if they're removed
+ */
+void lr_count_update(struct linked_ring *lr, lr_owner_t owner, long delta) {
+    struct lr_owner_slot *slot;
+
+    if(lr->quotas) {
+        lr_quota_count(lr, owner, delta);
+    }
+    if(lr_longest(lr) && (slot = lr_index_find(lr, owner))) {
+        lr_longest_sift(lr, slot->heap);
+    }
+
+    if(lr->high == 0) {
+        return;
+    }
+    if(!lr->above && lr->count >= lr->high) {
+        __atomic_store_n(&lr->above, 1, __ATOMIC_RELAXED);
+        lr_watermark_cross(lr, owner, LR_WATERMARK_RING_HIGH);
+    } else if(lr->above && lr->count <= lr->low) {
+        __atomic_store_n(&lr->above, 0, __ATOMIC_RELAXED);
+        lr_watermark_cross(lr, owner, LR_WATERMARK_RING_LOW);
+    }
+}
+
+/**
+ * Number of elements the owner could add. Cells reserved for other owners
+ * aren't taken, and the owner doesn't exceed its maximum.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ * @param new_owner: 1 if the owner needs the owner cell, 0 otherwise
+ *
+ * @return number of elements
+ */
+size_t lr_quota_room(struct linked_ring *lr, lr_owner_t owner, int new_owner) {
+    struct lr_owner_quota *quota;
+    size_t reserved;
+    size_t room;
+
+    quota = lr_quota_find(lr, owner);
+    if(quota && lr_quota_empty(quota)) {
+        quota = NULL;
+    }
+
+    /* Own reservation isn't kept from the owner */
+    reserved = lr->reserved + new_owner;
+    if(quota) {
+        reserved -= lr_quota_unmet(quota);
+    }
+
+    room = lr_available(lr);
+    room = room > reserved ? room - reserved : 0;
+    if(quota && quota->max) {
+        if(quota->count >= quota->max) {
+            return 0;
+        }
+        if(room > quota->max - quota->count) {
+            room = quota->max - quota->count;
+        }
+    }
+
+    return room;
+}
+
+/**
+ * Drop the oldest element of the owner and release its cell. The owner cell
+ * is released with the last element.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell
+ */
+void lr_owner_shift(struct linked_ring *lr, struct lr_cell *owner_cell) {
+    struct lr_cell *prev_owner;
+    struct lr_cell *prev_tail;
+    struct lr_cell *head;
+    struct lr_owner_slot *slot;
+
+    if(owner_cell == lr_last_cell(lr)) {
+        prev_owner = lr->owners;
+    } else {
+        prev_owner = owner_cell + 1;
+    }
+    prev_tail = lr_owner_tail(lr, prev_owner);
+    head = lr_cell_next(lr, prev_tail);
+    lr_cell_link(lr, prev_tail, lr_cell_next(lr, head));
+
+    lr->count -= 1;
+    if(lr->index) {
+        slot = lr_index_find(lr, lr_cell_data(lr, owner_cell));
+        slot->count -= 1;
+    }
+    lr_count_sub(lr, lr_cell_data(lr, owner_cell), 1);
+
+    if(head == lr_owner_tail(lr, owner_cell)) {
+        lr_owner_retire(lr, owner_cell);
+    }
+    lr_cell_release(lr, head);
+}
+
+/**
+ * Drop oldest elements by the overflow policy, until cells for the element
+ * of the owner are available. The new owner needs the owner cell too. Each
+ * dropped element frees at least one cell, so it takes no more than two.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner of the new element
+ */
+void lr_overflow(struct linked_ring *lr, lr_owner_t owner) {
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    size_t needed;
+
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    needed = owner_cell ? 1 : 2;
+
+    for(size_t dropped = 0; dropped < needed && lr_available(lr) < needed && lr->count; dropped++) {
+        if(lr_longest(lr)) {
+            owner_cell = lr_index_find(lr, lr->index[0].heap_owner)->cell;
+        } else if(lr->overflow != LR_OVERFLOW_OWNER || owner_cell == NULL) {
+            owner_cell = lr_last_cell(lr) - lr->overflow_next % lr_owners_count(lr);
+            lr->overflow_next += 1;
+        }
+
+        lr_owner_shift(lr, owner_cell);
+        lr->dropped += 1;
+
+        /* Owner cells are moved when an owner is retired */
+        owner_cell = lr_owner_find(lr, owner, &slot);
+    }
+}
+
+#if defined(LR_CELL_TIME)
+/**
+ * TTL of elements of the owner, its own one or TTL of the ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ *
+ * @return TTL, 0 if elements of the owner don't expire
+ */
+lr_time_t lr_owner_ttl(struct linked_ring *lr, lr_owner_t owner) {
+    struct lr_owner_quota *quota;
+
+    if(lr->ttls) {
+        quota = lr_quota_find(lr, owner);
+        if(quota && !lr_quota_empty(quota) && quota->ttl) {
+            return quota->ttl;
+        }
+    }
+
+    return lr->ttl;
+}
+
+/**
+ * Drop expired elements from the head of the owner chain. Elements of the
+ * owner are stamped in order, so it stops at the first one that isn't
+ * expired.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell
+ * @param now: current time of the clock of the ring
+ * @param budget: number of cells left to check, decreased by checked ones
+ *
+ * @return number of expired elements, the owner is retired if it's the
+ *         number of its elements
+ */
+size_t lr_expire_owner(struct linked_ring *lr, struct lr_cell *owner_cell,
+                       lr_time_t now, size_t *budget) {
+    struct lr_cell *prev_owner;
+    struct lr_cell *head;
+    lr_time_t ttl;
+    size_t expired;
+    int last;
+
+    ttl = lr_owner_ttl(lr, lr_cell_data(lr, owner_cell));
+    if(ttl == 0) {
+        *budget -= 1;
+
+        return 0;
+    }
+
+    expired = 0;
+    last = 0;
+    while(*budget && !last) {
+        if(owner_cell == lr_last_cell(lr)) {
+            prev_owner = lr->owners;
+        } else {
+            prev_owner = owner_cell + 1;
+        }
+        head = lr_cell_next(lr, lr_owner_tail(lr, prev_owner));
+
+        *budget -= 1;
+        if(now < head->time || now - head->time < ttl) {
+            break;
+        }
+
+        last = head == lr_owner_tail(lr, owner_cell);
+        lr_owner_shift(lr, owner_cell);
+        expired++;
+    }
+    lr->expired += expired;
+
+    return expired;
+}
+
+/**
+ * Expire elements of owners in turn, until the budget of checked cells is
+ * spent or each owner is checked once. The turn is kept in the ring, so
+ * following calls continue with the next owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param now: current time of the clock of the ring
+ * @param budget: number of cells to check
+ *
+ * @return number of expired elements
+ */
+size_t lr_expire_some(struct linked_ring *lr, lr_time_t now, size_t budget) {
+    struct lr_cell *owner_cell;
+    size_t owners_nr;
+    size_t expired;
+    size_t count;
+
+    expired = 0;
+    owners_nr = (size_t) lr_owners_count(lr);
+    for(size_t checked = 0; checked < owners_nr && budget && lr->owners; checked++) {
+        count = (size_t) lr_owners_count(lr);
+        owner_cell = lr_last_cell(lr) - lr->expire_next % count;
+        expired += lr_expire_owner(lr, owner_cell, now, &budget);
+
+        /* Retired owner is replaced by the last one, which takes its turn */
+        if((size_t) lr_owners_count(lr) == count) {
+            lr->expire_next += 1;
+        }
+    }
+
+    return expired;
+}
+#endif
+
+struct lr_cell* lr_owner_get(struct linked_ring *lr, lr_data_t owner, struct lr_owner_slot **slot) {
+    struct lr_cell *owner_cell = NULL;
+
+    /* Find the owner cell in the linked ring buffer */
+    owner_cell = lr_owner_find(lr, owner, slot);
+    if(owner_cell)
+        return owner_cell;
+
+    /* New owner needs cells for the owner and for the data */
+    if(lr_available(lr) < 2)
+        return NULL;
+
+    /* Index should keep at least one empty slot */
+    if(lr->index && (size_t) lr_owners_count(lr) + 1 >= lr->index_size)
+        return NULL;
+
+    /* Allocate a new owner cell and update the owners array */
+    owner_cell = lr_owner_allocate(lr);
+    if(owner_cell == NULL) {
+        /* The cell is taken from the lock-free pool by lr_put() */
+        return NULL;
+    }
+    lr->owners = owner_cell;
+    lr_cell_data(lr, owner_cell) = owner;
+    lr_cell_link(lr, owner_cell, (struct lr_cell *) NULL);
+
+    if(lr->index)
+        *slot = lr_index_insert(lr, owner, owner_cell);
+
+    return owner_cell;
+}
+
+
+/**
+ * Count the elements in the chain of the owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell
+ * @param limit: maximum number of elements to count (0 for no limit)
+ *
+ * @return the number of elements in the chain (up to the limit, if specified)
+ */
+size_t lr_owner_length(struct linked_ring *lr, struct lr_cell *owner_cell, size_t limit) {
+    struct lr_cell *needle;
+    struct lr_cell *tail;
+    size_t length;
+
+    needle = lr_owner_head(lr, owner_cell);
+    tail = lr_owner_tail(lr, owner_cell);
+
+    length = 1;
+    while(needle != tail && length != limit) {
+        needle = lr_cell_next(lr, needle);
+        length += 1;
+    }
+
+    return length;
+}
+
+/**
+ * Set the owner index for a linked ring buffer. Owners already stored in
+ * the buffer are indexed immediately.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param slots: caller supplied array of slots, NULL to disable the index
+ * @param slots_nr: number of slots, should be power of two and exceed the
+ *                  maximum number of owners
+ *
+ * @return LR_OK: if the index was set
+ *         LR_ERROR_NOMEMORY: if slots_nr isn't power of two or too small
+ */
+lr_result_t lr_set_index(struct linked_ring *lr, struct lr_owner_slot *slots,
+                         size_t slots_nr)
+{
+    struct lr_owner_slot *slot;
+
+    if (slots == NULL) {
+        lr->index      = NULL;
+        lr->index_size = 0;
+
+        return LR_OK;
+    }
+
+    if (slots_nr == 0 || (slots_nr & (slots_nr - 1)) != 0
+        || slots_nr <= (size_t) lr_owners_count(lr)) {
+        return LR_ERROR_NOMEMORY;
+    }
+
+    lr->index      = slots;
+    lr->index_size = slots_nr;
+    lr->longest_nr = 0;
+    for (size_t idx = 0; idx < slots_nr; idx++) {
+        slots[idx].cell = NULL;
+    }
+
+    for (struct lr_cell *owner_cell = lr->owners; owner_cell && owner_cell < lr->cells + lr->size; owner_cell++) {
+        slot = lr_index_insert(lr, lr_cell_data(lr, owner_cell), owner_cell);
+        slot->count = lr_owner_length(lr, owner_cell, 0);
+        if (lr_longest(lr)) {
+            lr_longest_sift(lr, slot->heap);
+        }
+    }
+
+    return LR_OK;
+}
+
+
+
+
+/**
+ * Count the number of elements owned by the specified owner in the linked ring buffer.
+ * If limit is specified, it will stop counting after reaching the limit.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * @param limit: maximum number of elements to count (0 for no limit)
+ * @param owner: the owner of the elements to count (0 for all owners)
+ * 
+ * @return the number of elements owned by the specified owner (up to the limit, if specified)
+ */
+size_t lr_count_limited_owned(struct linked_ring *lr, size_t limit,
+                                lr_owner_t owner)
+{
+    size_t length;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+
+
+    lock(lr, owner);
+
+    length = 0;
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        unlock_and_return(lr, owner, length);
+    }
+
+    /* Indexed owners keep the number of elements */
+    if(slot) {
+        length = slot->count;
+        if(limit && length > limit) {
+            length = limit;
+        }
+    } else {
+        length = lr_owner_length(lr, owner_cell, limit);
+    }
+
+    unlock_and_return(lr, owner, length);
+}
+
+/**
+ * Count the number of elements in the linked ring buffer. The number is
+ * maintained by lr_put() and lr_get(), so the lock isn't taken.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * 
+ * @return the number of elements in the buffer
+ */
+size_t lr_count(struct linked_ring *lr) {
+    return lr->count;
+}
+
+#if defined(LR_EVENTFD)
+/**
+ * Increment the counter of the eventfd, so it becomes readable.
+ *
+ * @param fd: the eventfd
+ */
+void lr_eventfd_signal(int fd)
+{
+    uint64_t one = 1;
+
+    /* The counter could only overflow if nobody reads it, skip it then */
+    if(write(fd, &one, sizeof(one)) < 0) {
+        return;
+    }
+}
+
+/**
+ * Find the event slot of the owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner to look up
+ *
+ * @return pointer to the slot of the owner, or to the empty slot where it
+ *         should be inserted, NULL if the table is full
+ */
+struct lr_owner_event* lr_event_find(struct linked_ring *lr, lr_owner_t owner) {
+    struct lr_owner_event *event;
+    size_t idx;
+
+    idx = lr_event_hash(lr, owner);
+    for (size_t probe = 0; probe < lr->events_nr; probe++) {
+        event = &lr->events[idx];
+        if (event->fd < 0 || event->owner == owner) {
+            return event;
+        }
+        idx = (idx + 1) & (lr->events_nr - 1);
+    }
+
+    return NULL;
+}
+
+/**
+ * Signal eventfds when the owner gets data while it has none.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell with empty chain
+ */
+void lr_event_data(struct linked_ring *lr, struct lr_cell *owner_cell) {
+    struct lr_owner_event *event;
+
+    if(lr->count == 0 && lr->data_fd >= 0) {
+        lr_eventfd_signal(lr->data_fd);
+    }
+
+    if(lr->events) {
+        event = lr_event_find(lr, lr_cell_data(lr, owner_cell));
+        if(event && event->fd >= 0) {
+            lr_eventfd_signal(event->fd);
+        }
+    }
+}
+#endif
+
+/**
+ * Append the run of linked cells to the chain of the owner. Chain of a new
+ * owner is linked after the chain of the previous owner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner_cell: pointer to the owner cell
+ * @param first: pointer to the first cell of the run
+ * @param last: pointer to the last cell of the run
+ */
+void lr_owner_append(struct linked_ring *lr, struct lr_cell *owner_cell,
+                     struct lr_cell *first, struct lr_cell *last)
+{
+    struct lr_cell *tail;
+    struct lr_cell *prev_tail;
+    struct lr_cell *needle;
+    struct lr_cell *prev;
+
+    tail = lr_owner_tail(lr, owner_cell);
+#if defined(LR_EVENTFD)
+    if(tail == NULL) {
+        lr_event_data(lr, owner_cell);
+    }
+#endif
+    if(tail) {
+        /* If owner allready exists*/
+        lr_cell_link(lr, last, lr_cell_next(lr, tail));
+        lr_cell_link(lr, tail, first);
+    } else if(owner_cell < lr_last_cell(lr)) {
+        /* If new owner and prev owner exists */
+        prev_tail = lr_owner_tail(lr, owner_cell + 1);
+        lr_cell_link(lr, last, lr_cell_next(lr, prev_tail));
+        lr_cell_link(lr, prev_tail, first);
+    } else {
+        /* If first owner */
+        lr_cell_link(lr, last, first);
+    }
+
+    lr_cell_link(lr, owner_cell, last);
+
+    /* The cell taken last from the reserve is looked up in the run, callers
+     * have built the run cell by cell anyway */
+    if(lr->pinned_owner == NULL && lr->pinned == lr_owners_base(lr) - lr->reserve - 1) {
+        prev = tail;
+        for(needle = first; needle != lr->pinned && needle != last; needle = lr_cell_next(lr, needle)) {
+            prev = needle;
+        }
+        if(needle == lr->pinned) {
+            lr->pinned_owner = owner_cell;
+            lr->pinned_prev  = prev;
+        }
+    }
+}
+
+#if defined(LR_WAIT_FUTEX)
+/**
+ * Count the change of the wait word and wake its waiters, if there are any.
+ *
+ * @param word: pointer to the wait word
+ */
+void lr_wait_signal(lr_lock_t *word)
+{
+    lr_lock_t seq;
+
+    seq = __atomic_load_n(word, __ATOMIC_RELAXED);
+    while(!__atomic_compare_exchange_n(word, &seq, (seq + 1) & ~LR_WAIT_PARKED,
+                                       1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    }
+
+    if(seq & LR_WAIT_PARKED) {
+        lr_futex_wake(word, INT_MAX);
+    }
+}
+#endif
+
+void lr_spin_lock(lr_lock_t *lock)
+{
+    unsigned int spins = 0;
+
+    while(__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE)) {
+        while(__atomic_load_n(lock, __ATOMIC_RELAXED)) {
+            lr_spin_relax(spins);
+        }
+    }
+}
+
+void lr_spin_unlock(lr_lock_t *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Owner locks of lr_set_owner_locks(), the state is the array of lock words */
+enum lr_result lr_spin_owner_lock(void *state, size_t lock)
+{
+    lr_spin_lock((lr_lock_t *) state + lock);
+
+    return LR_OK;
+}
+
+enum lr_result lr_spin_owner_unlock(void *state, size_t lock)
+{
+    lr_spin_unlock((lr_lock_t *) state + lock);
+
+    return LR_OK;
+}
+
+/**
+ * Enter the ring as one of operations sharing it. Owners and the index don't
+ * change until all of them leave.
+ *
+ * @param lr: pointer to the linked ring structure
+ */
+void lr_shared_lock(struct linked_ring *lr)
+{
+    lr_lock_t users;
+    unsigned int spins = 0;
+
+    users = __atomic_load_n(&lr->users, __ATOMIC_RELAXED);
+    do {
+        while(users & LR_USERS_EXCLUSIVE) {
+            lr_spin_relax(spins);
+            users = __atomic_load_n(&lr->users, __ATOMIC_RELAXED);
+        }
+    } while(!__atomic_compare_exchange_n(&lr->users, &users, users + 1, 1,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+}
+
+void lr_shared_unlock(struct linked_ring *lr)
+{
+    __atomic_fetch_sub(&lr->users, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Lock of the ring installed by lr_set_owner_locks(). New shared operations
+ * wait for the flag, then the lock waits for the running ones to leave.
+ *
+ * @param state: pointer to the linked ring structure
+ * @param owner: unused
+ *
+ * @return LR_OK
+ */
+enum lr_result lr_exclusive_lock(void *state, lr_owner_t owner)
+{
+    struct linked_ring *lr = (struct linked_ring *) state;
+    lr_lock_t users;
+    unsigned int spins = 0;
+
+    (void) owner;
+
+    users = __atomic_load_n(&lr->users, __ATOMIC_RELAXED);
+    do {
+        while(users & LR_USERS_EXCLUSIVE) {
+            lr_spin_relax(spins);
+            users = __atomic_load_n(&lr->users, __ATOMIC_RELAXED);
+        }
+    } while(!__atomic_compare_exchange_n(&lr->users, &users,
+                                         users | LR_USERS_EXCLUSIVE, 1,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    while(__atomic_load_n(&lr->users, __ATOMIC_ACQUIRE) != LR_USERS_EXCLUSIVE) {
+        lr_spin_relax(spins);
+    }
+
+    return LR_OK;
+}
+
+enum lr_result lr_exclusive_unlock(void *state, lr_owner_t owner)
+{
+    struct linked_ring *lr = (struct linked_ring *) state;
+
+    (void) owner;
+
+    __atomic_store_n(&lr->users, 0, __ATOMIC_RELEASE);
+
+    return LR_OK;
+}
+
+/**
+ * Set the mutex for a linked ring buffer. If the attributes have per-owner
+ * locks, the ring is shared between owners as described in
+ * lr_set_owner_locks(), but with lock objects of the caller.
+ * 
+ * @param lr: pointer to the linked ring structure to be initialized
+ * @param attr: mutex attributes
+ *
+ * @return LR_OK: if the mutex is set
+ *         LR_ERROR_NOMEMORY: if owner_locks_nr isn't a power of two
+ *         LR_ERROR_LOCK: if the lock is fixed by LR_LOCK at build time, or
+ *                        owner locks are set for packed cells, whose links
+ *                        couldn't be accessed with atomics
+ */
+lr_result_t lr_set_mutex(struct linked_ring *lr, struct lr_mutex_attr *attr)
+{
+#if LR_LOCK != LR_LOCK_DYNAMIC
+    if(attr->lock != NULL || attr->unlock != NULL || attr->owner_lock != NULL) {
+        return LR_ERROR_LOCK;
+    }
+#endif
+#if defined(LR_CELL_UNALIGNED)
+    if(attr->owner_lock != NULL) {
+        return LR_ERROR_LOCK;
+    }
+#endif
+
+    if(attr->owner_lock == NULL) {
+        lr->owner_lock        = NULL;
+        lr->owner_unlock      = NULL;
+        lr->owner_locks_state = NULL;
+        lr->owner_locks_nr    = 0;
+
+        lr->lock = attr->lock;
+        lr->unlock = attr->unlock;
+        lr->mutex_state = attr->state;
+
+        return LR_OK;
+    }
+
+    if(attr->owner_unlock == NULL || attr->owner_locks_nr == 0
+       || (attr->owner_locks_nr & (attr->owner_locks_nr - 1)) != 0) {
+        return LR_ERROR_NOMEMORY;
+    }
+
+    lr->owner_lock        = attr->owner_lock;
+    lr->owner_unlock      = attr->owner_unlock;
+    lr->owner_locks_state = attr->state;
+    lr->owner_locks_nr    = attr->owner_locks_nr;
+    lr->users             = 0;
+    lr->pool_lock         = 0;
+
+    lr->lock        = lr_exclusive_lock;
+    lr->unlock      = lr_exclusive_unlock;
+    lr->mutex_state = lr;
+
+    return LR_OK;
+}
+
+/**
+ * Share the ring between owners. Put and get of an existing owner take only
+ * the lock of the link they change: lr_put() locks the link from the tail of
+ * the owner, lr_get() the link from the tail of the previous owner to the
+ * head. So the producer and the consumer of an owner don't wait for each
+ * other, as well as operations of owners, which aren't neighbours in the
+ * ring. New owners, retirement and the rest of operations lock the whole
+ * ring. It replaces the mutex set by lr_set_mutex(), and should be called
+ * before the ring is shared between threads.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param locks: pointer to the array of locks, NULL to disable owner locks
+ * @param locks_nr: number of locks, power of two. Owners with the same
+ *                  position modulo number of locks share the lock
+ *
+ * @return LR_OK: if the owner locks are set
+ *         LR_ERROR_NOMEMORY: if locks_nr isn't a power of two
+ *         LR_ERROR_LOCK: if the lock is fixed by LR_LOCK at build time, or
+ *                        cells are packed
+ */
+lr_result_t lr_set_owner_locks(struct linked_ring *lr, lr_lock_t *locks,
+                               size_t locks_nr)
+{
+    struct lr_mutex_attr attr = {0};
+
+    if(locks != NULL) {
+        if(locks_nr == 0 || (locks_nr & (locks_nr - 1)) != 0) {
+            return LR_ERROR_NOMEMORY;
+        }
+
+        for(size_t idx = 0; idx < locks_nr; idx++) {
+            locks[idx] = 0;
+        }
+
+        attr.state          = locks;
+        attr.owner_locks_nr = locks_nr;
+        attr.owner_lock     = lr_spin_owner_lock;
+        attr.owner_unlock   = lr_spin_owner_unlock;
+    }
+
+    return lr_set_mutex(lr, &attr);
+}
+
+/* Node of the thread queued in the MCS lock */
+struct lr_mcs_node {
+    struct lr_mcs_node *next;   // Thread queued after this one
+    struct lr_mcs_lock *lock;   // Lock the node is used for, NULL if free
+    lr_lock_t           locked; // Cleared when the lock is handed over
+};
+
+/* Nodes of MCS locks held or waited by the thread */
+static _Thread_local struct lr_mcs_node lr_mcs_nodes[LR_MCS_NODES];
+
+/**
+ * Ticket lock. The thread takes the next ticket and waits until it's served.
+ *
+ * @param state: pointer to the struct lr_ticket_lock
+ * @param owner: unused
+ *
+ * @return LR_OK
+ */
+enum lr_result lr_ticket_lock(void *state, lr_owner_t owner)
+{
+    struct lr_ticket_lock *ticket = (struct lr_ticket_lock *) state;
+
+    (void) owner;
+
+    lr_ticket_wait(ticket, __atomic_fetch_add(&ticket->next, 1, __ATOMIC_RELAXED));
+
+    return LR_OK;
+}
+
+/* Wait until the ticket is served */
+void lr_ticket_wait(struct lr_ticket_lock *ticket, lr_lock_t mine)
+{
+    unsigned int spins = 0;
+
+    while(__atomic_load_n(&ticket->serving, __ATOMIC_ACQUIRE) != mine) {
+        lr_spin_relax(spins);
+    }
+}
+
+enum lr_result lr_ticket_unlock(void *state, lr_owner_t owner)
+{
+    struct lr_ticket_lock *ticket = (struct lr_ticket_lock *) state;
+
+    (void) owner;
+
+    /* Only the holder changes the served ticket */
+    __atomic_store_n(&ticket->serving,
+                     __atomic_load_n(&ticket->serving, __ATOMIC_RELAXED) + 1,
+                     __ATOMIC_RELEASE);
+
+    return LR_OK;
+}
+
+enum lr_result lr_ticket_owner_lock(void *state, size_t lock)
+{
+    return lr_ticket_lock((struct lr_ticket_lock *) state + lock, 0);
+}
+
+enum lr_result lr_ticket_owner_unlock(void *state, size_t lock)
+{
+    return lr_ticket_unlock((struct lr_ticket_lock *) state + lock, 0);
+}
+
+/**
+ * MCS lock. The thread appends its node to the queue and spins on the node
+ * until the previous thread hands the lock over.
+ *
+ * @param state: pointer to the struct lr_mcs_lock
+ * @param owner: unused
+ *
+ * @return LR_OK: if the lock is acquired
+ *         LR_ERROR_LOCK: if the thread already holds the lock, or holds
+ *                        LR_MCS_NODES locks
+ */
+enum lr_result lr_mcs_lock(void *state, lr_owner_t owner)
+{
+    struct lr_mcs_lock *mcs  = (struct lr_mcs_lock *) state;
+    struct lr_mcs_node *node = NULL;
+    struct lr_mcs_node *prev;
+    unsigned int spins = 0;
+
+    (void) owner;
+
+    for(size_t idx = 0; idx < LR_MCS_NODES; idx++) {
+        if(lr_mcs_nodes[idx].lock == mcs) {
+            return LR_ERROR_LOCK;
+        }
+
+        if(node == NULL && lr_mcs_nodes[idx].lock == NULL) {
+            node = &lr_mcs_nodes[idx];
+        }
+    }
+
+    if(node == NULL) {
+        return LR_ERROR_LOCK;
+    }
+
+    node->lock = mcs;
+    node->next = NULL;
+    node->locked = 1;
+
+    prev = __atomic_exchange_n(&mcs->tail, node, __ATOMIC_ACQ_REL);
+    if(prev != NULL) {
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while(__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            lr_spin_relax(spins);
+        }
+    }
+
+    return LR_OK;
+}
+
+enum lr_result lr_mcs_unlock(void *state, lr_owner_t owner)
+{
+    struct lr_mcs_lock *mcs  = (struct lr_mcs_lock *) state;
+    struct lr_mcs_node *node = NULL;
+    struct lr_mcs_node *next;
+    struct lr_mcs_node *expected;
+    unsigned int spins = 0;
+
+    (void) owner;
+
+    for(size_t idx = 0; idx < LR_MCS_NODES; idx++) {
+        if(lr_mcs_nodes[idx].lock == mcs) {
+            node = &lr_mcs_nodes[idx];
+            break;
+        }
+    }
+
+    if(node == NULL) {
+        return LR_ERROR_UNLOCK;
+    }
+
+    next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if(next == NULL) {
+        expected = node;
+        if(__atomic_compare_exchange_n(&mcs->tail, &expected, NULL, 0,
+                                       __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            node->lock = NULL;
+
+            return LR_OK;
+        }
+
+        /* The next thread has swapped the tail, but isn't linked yet */
+        while((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == NULL) {
+            lr_spin_relax(spins);
+        }
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+    node->lock = NULL;
+
+    return LR_OK;
+}
+
+/**
+ * Adaptive mutex. The thread spins while the holder is likely to leave soon,
+ * then marks the mutex contended and sleeps on the futex.
+ *
+ * @param state: pointer to the struct lr_adaptive_lock
+ * @param owner: unused
+ *
+ * @return LR_OK
+ */
+enum lr_result lr_adaptive_lock(void *state, lr_owner_t owner)
+{
+    struct lr_adaptive_lock *adaptive = (struct lr_adaptive_lock *) state;
+    lr_lock_t expected;
+
+    (void) owner;
+
+    for(unsigned int spins = 0; spins < LR_SPIN_LIMIT; spins++) {
+        expected = 0;
+        if(__atomic_load_n(&adaptive->state, __ATOMIC_RELAXED) == 0
+           && __atomic_compare_exchange_n(&adaptive->state, &expected, 1, 1,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return LR_OK;
+        }
+    }
+
+    while(__atomic_exchange_n(&adaptive->state, 2, __ATOMIC_ACQUIRE) != 0) {
+#if defined(__linux__)
+        lr_futex_wait(&adaptive->state, 2, NULL);
+#else
+        lr_spin_yield();
+#endif
+    }
+
+    return LR_OK;
+}
+
+enum lr_result lr_adaptive_unlock(void *state, lr_owner_t owner)
+{
+    struct lr_adaptive_lock *adaptive = (struct lr_adaptive_lock *) state;
+
+    (void) owner;
+
+    if(__atomic_exchange_n(&adaptive->state, 0, __ATOMIC_RELEASE) == 2) {
+#if defined(__linux__)
+        lr_futex_wake(&adaptive->state, 1);
+#endif
+    }
+
+    return LR_OK;
+}
+
+enum lr_result lr_adaptive_owner_lock(void *state, size_t lock)
+{
+    return lr_adaptive_lock((struct lr_adaptive_lock *) state + lock, 0);
+}
+
+enum lr_result lr_adaptive_owner_unlock(void *state, size_t lock)
+{
+    return lr_adaptive_unlock((struct lr_adaptive_lock *) state + lock, 0);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/* Wrapper of pthread_mutex_t, which is the state */
+enum lr_result lr_pthread_lock(void *state, lr_owner_t owner)
+{
+    (void) owner;
+
+    if(pthread_mutex_lock((pthread_mutex_t *) state) != 0) {
+        return LR_ERROR_LOCK;
+    }
+
+    return LR_OK;
+}
+
+enum lr_result lr_pthread_unlock(void *state, lr_owner_t owner)
+{
+    (void) owner;
+
+    if(pthread_mutex_unlock((pthread_mutex_t *) state) != 0) {
+        return LR_ERROR_UNLOCK;
+    }
+
+    return LR_OK;
+}
+#endif
+
+/**
+ * Release the cell, sharing the ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param cell: pointer to the released cell
+ * @param spare: number of other free cells
+ */
+void lr_cell_release_shared(struct linked_ring *lr, struct lr_cell *cell,
+                            size_t spare)
+{
+#if defined(LR_POOL_LOCKFREE)
+    /* The pinned cell returns to the reserve, which is shared under the
+     * pool lock */
+    if(cell == lr->pinned) {
+        lr_spin_lock(&lr->pool_lock);
+        lr_cell_release(lr, cell);
+        lr_spin_unlock(&lr->pool_lock);
+
+        return;
+    }
+
+    lr_pool_give(lr, cell, spare);
+#else
+    (void) spare;
+
+    lr_spin_lock(&lr->pool_lock);
+    lr_cell_release(lr, cell);
+    lr_spin_unlock(&lr->pool_lock);
+#endif
+}
+
+/**
+ * Append the element to the chain of the existing owner, sharing the ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: the data to be added
+ * @param owner: the owner of the element
+ *
+ * @return LR_OK: if the element was added
+ *         LR_ERROR_BUFFER_BUSY: if the ring should be locked, because the
+ *                               owner is new or there are no free cells
+ *         LR_ERROR_LOCK, LR_ERROR_UNLOCK: if the owner lock failed
+ */
+lr_result_t lr_put_shared(struct linked_ring *lr, lr_data_t data,
+                          lr_owner_t owner)
+{
+    struct lr_cell *cell;
+    struct lr_cell *tail;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    size_t link_lock;
+    size_t reserve;
+    lr_result_t result;
+
+    lr_shared_lock(lr);
+
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        lr_shared_unlock(lr);
+
+        return LR_ERROR_BUFFER_BUSY;
+    }
+
+    cell = NULL;
+    reserve = 0;
+#if defined(LR_POOL_LOCKFREE)
+    cell = lr_pool_take(lr);
+#endif
+    if(cell == NULL) {
+        /* Reserve is shared under the pool lock */
+        lr_spin_lock(&lr->pool_lock);
+        reserve = lr->reserve;
+        cell = lr_cell_alloc(lr);
+        reserve -= lr->reserve;
+        lr_spin_unlock(&lr->pool_lock);
+    }
+    if(cell == NULL) {
+        lr_shared_unlock(lr);
+
+        return LR_ERROR_BUFFER_BUSY;
+    }
+    lr_cell_data(lr, cell) = data;
+    lr_cell_stamp(lr, cell, lr_now(lr));
+
+    link_lock = lr_owner_lock_nr(lr, owner_cell);
+    result = lr->owner_lock(lr->owner_locks_state, link_lock);
+    if(result != LR_OK) {
+        lr_cell_release_shared(lr, cell, 0);
+        lr_shared_unlock(lr);
+
+        return result;
+    }
+
+    tail = lr_owner_tail(lr, owner_cell);
+    lr_cell_link(lr, cell, lr_cell_next(lr, tail));
+    lr_cell_link(lr, tail, cell);
+    lr_owner_link_release(lr, owner_cell, cell);
+    if(reserve) {
+        /* The cell taken from the reserve is pinned, as lr_owner_append()
+         * does, unless others took the reserve since */
+        lr_spin_lock(&lr->pool_lock);
+        if(lr->pinned == cell && lr->pinned_owner == NULL) {
+            lr->pinned_owner = owner_cell;
+            lr->pinned_prev  = tail;
+        }
+        lr_spin_unlock(&lr->pool_lock);
+    }
+
+    result = lr->owner_unlock(lr->owner_locks_state, link_lock);
+
+    __atomic_add_fetch(&lr->count, 1, __ATOMIC_RELAXED);
+    if(slot)
+        __atomic_add_fetch(&slot->count, 1, __ATOMIC_RELAXED);
+    lr_wait_signal_owner(lr, owner);
+
+    lr_shared_unlock(lr);
+
+    return result;
+}
+
+/**
+ * Add a new element to the linked ring buffer locked by the caller.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: the data to be added to the buffer
+ * @param owner: the owner of the new element
+ * @param cell: free cell taken before the ring was locked, NULL to allocate
+ *
+ * @return LR_OK: if the element was successfully added
+ *         LR_ERROR_BUFFER_FULL: if the buffer is full and the element could not be added
+ */
+lr_result_t lr_put_locked(struct linked_ring *lr, lr_data_t data, lr_owner_t owner,
+                          struct lr_cell *cell)
+{
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+
+#if LR_LOCK == LR_LOCK_DYNAMIC
+#if defined(LR_CELL_TIME)
+    if(lr_expiring(lr) && lr_available(lr) < 2) {
+        /* Expired elements are reclaimed lazily when free cells run out */
+        lr_expire_some(lr, lr_now(lr), LR_EXPIRE_BUDGET);
+    }
+#endif
+    if(lr->overflow != LR_OVERFLOW_FAIL && lr_available(lr) < 2) {
+        lr_overflow(lr, owner);
+    }
+#endif
+    if(lr_available(lr) == 0) {
+        return LR_ERROR_BUFFER_FULL;
+    }
+
+    owner_cell = lr_owner_find(lr, owner, &slot);
+#if LR_LOCK == LR_LOCK_DYNAMIC
+    if(lr->quotas && lr_quota_room(lr, owner, owner_cell == NULL) == 0) {
+        /* The owner reached its maximum, or free cells are reserved */
+        if(cell) {
+            lr_cell_release(lr, cell);
+            lr_wait_signal_space(lr);
+            lr_event_space(lr, lr_available(lr) == 1);
+        }
+        return LR_ERROR_BUFFER_FULL;
+    }
+#endif
+    if(owner_cell == NULL) {
+        /* New owner cell is allocated first, as it's at the specific position */
+        if(cell) {
+            lr_cell_release(lr, cell);
+            lr_wait_signal_space(lr);
+            lr_event_space(lr, lr_available(lr) == 1);
+            cell = NULL;
+        }
+
+        owner_cell = lr_owner_get(lr, owner, &slot);
+        if(owner_cell == NULL) {
+            return LR_ERROR_BUFFER_FULL;
+        }
+    }
+
+    if(cell == NULL) {
+        cell = lr_cell_alloc(lr);
+    }
+    if(cell == NULL) {
+        /* Free cells are taken from the lock-free pool by others */
+        lr_owner_abandon(lr, owner_cell);
+        return LR_ERROR_BUFFER_FULL;
+    }
+    lr_cell_data(lr, cell) = data;
+    lr_cell_stamp(lr, cell, lr_now(lr));
+
+    lr_owner_append(lr, owner_cell, cell, cell);
+
+    lr->count += 1;
+    if(slot)
+        slot->count += 1;
+    lr_count_add(lr, owner, 1);
+    lr_wait_signal_owner(lr, owner);
+
+    return LR_OK;
+}
+
+/**
+ * Add a new element to the linked ring buffer, without flat combining.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * @param data: the data to be added to the buffer
+ * @param owner: the owner of the new element
+ * 
+ * @return LR_OK: if the element was successfully added
+ *         LR_ERROR_BUFFER_FULL: if the buffer is full and the element could not be added
+ */
+lr_result_t lr_put_direct(struct linked_ring *lr, lr_data_t data, lr_data_t owner)
+{
+    struct lr_cell *cell;
+    lr_result_t result;
+
+#if LR_LOCK == LR_LOCK_DYNAMIC
+    /* Quotas and watermarks are counted under the mutex */
+    if(lr->owner_lock && !lr_counted(lr)) {
+        result = lr_put_shared(lr, data, owner);
+        if(result != LR_ERROR_BUFFER_BUSY) {
+            return result;
+        }
+    }
+#endif
+
+    cell = NULL;
+#if defined(LR_POOL_LOCKFREE)
+    /* Take the cell before the ring is locked, the reserve is used under the
+     * lock if the pool is empty */
+    __atomic_add_fetch(&lr->taken, 1, __ATOMIC_RELAXED);
+    cell = lr_pool_take(lr);
+    if(cell == NULL) {
+        __atomic_sub_fetch(&lr->taken, 1, __ATOMIC_RELAXED);
+    }
+#endif
+
+    lock_or_release(lr, owner, cell);
+
+#if defined(LR_POOL_LOCKFREE)
+    if(cell) {
+        /* The cell is counted as available while the ring is locked */
+        __atomic_sub_fetch(&lr->taken, 1, __ATOMIC_RELAXED);
+    }
+#endif
+    result = lr_put_locked(lr, data, owner, cell);
+
+    unlock_and_return(lr, owner, result);
+}
+
+/**
+ * Add elements to the linked ring buffer. The owner is resolved and the
+ * elements are linked to its chain under a single lock. Elements that don't
+ * fit in the buffer are not added.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param src: pointer to the data to be added
+ * @param n: number of elements to be added
+ * @param owner: the owner of the new elements
+ *
+ * @return the number of added elements
+ */
+size_t lr_put_many(struct linked_ring *lr, const lr_data_t *src, size_t n,
+                   lr_owner_t owner)
+{
+    struct lr_cell *first;
+    struct lr_cell *last;
+    struct lr_cell *cell;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    size_t room;
+    size_t put;
+#if defined(LR_CELL_TIME)
+    lr_time_t now;
+#endif
+
+    if(n == 0) {
+        return 0;
+    }
+
+    lock_or_return(lr, owner, 0);
+#if defined(LR_CELL_TIME)
+    now = lr_now(lr);
+#endif
+
+    put = 0;
+    if(lr_available(lr) == 0) {
+        unlock_and_count(lr, owner, put);
+    }
+
+    if(lr->quotas) {
+        owner_cell = lr_owner_find(lr, owner, &slot);
+        room = lr_quota_room(lr, owner, owner_cell == NULL);
+        if(room == 0) {
+            unlock_and_count(lr, owner, put);
+        }
+        if(n > room) {
+            n = room;
+        }
+    }
+
+    owner_cell = lr_owner_get(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        unlock_and_count(lr, owner, put);
+    }
+
+    if(n > lr_available(lr)) {
+        n = lr_available(lr);
+    }
+
+    /* Link the run of cells, then append it to the chain of the owner */
+    first = lr_cell_alloc(lr);
+    if(first == NULL) {
+        /* Free cells are taken from the lock-free pool by others */
+        lr_owner_abandon(lr, owner_cell);
+        unlock_and_count(lr, owner, put);
+    }
+    lr_cell_data(lr, first) = src[0];
+    lr_cell_stamp(lr, first, now);
+    last = first;
+    for(put = 1; put < n; put++) {
+        cell = lr_cell_alloc(lr);
+        if(cell == NULL) {
+            break;
+        }
+        lr_cell_data(lr, cell) = src[put];
+        lr_cell_stamp(lr, cell, now);
+        lr_cell_link(lr, last, cell);
+        last = cell;
+    }
+
+    lr_owner_append(lr, owner_cell, first, last);
+
+    lr->count += put;
+    if(slot)
+        slot->count += put;
+    lr_count_add(lr, owner, put);
+    lr_wait_signal_owner(lr, owner);
+
+    unlock_and_count(lr, owner, put);
+}
+
+/**
+ * Add bytes to the linked ring buffer, one element per byte. Cells for all
+ * bytes are reserved under a single lock, so either all bytes are added or
+ * the buffer is left untouched.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param buf: pointer to the bytes to be added
+ * @param len: number of bytes
+ * @param owner: the owner of the new elements
+ *
+ * @return LR_OK: if all bytes were successfully added
+ *         LR_ERROR_BUFFER_FULL: if the buffer doesn't have room for all bytes
+ */
+lr_result_t lr_put_bytes(struct linked_ring *lr, const unsigned char *buf,
+                         size_t len, lr_owner_t owner)
+{
+    struct lr_cell *first;
+    struct lr_cell *last;
+    struct lr_cell *cell;
+    struct lr_cell *needle;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+#if defined(LR_CELL_TIME)
+    lr_time_t now;
+#endif
+
+    if(len == 0) {
+        return LR_OK;
+    }
+
+    lock(lr, owner);
+#if defined(LR_CELL_TIME)
+    now = lr_now(lr);
+#endif
+
+    /* New owner takes a cell as well */
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(len + (owner_cell == NULL) > lr_available(lr)
+       || (lr->quotas && len > lr_quota_room(lr, owner, owner_cell == NULL))) {
+        unlock_and_return(lr, owner, LR_ERROR_BUFFER_FULL);
+    }
+
+    owner_cell = lr_owner_get(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        unlock_and_return(lr, owner, LR_ERROR_BUFFER_FULL);
+    }
+
+    first = NULL;
+    last = NULL;
+    for(size_t idx = 0; idx < len; idx++) {
+        cell = lr_cell_alloc(lr);
+        if(cell == NULL) {
+            /* Free cells are taken from the lock-free pool by others. Cells
+             * are released in reverse order, so the reserve is restored */
+            for(cell = NULL; first; cell = needle) {
+                needle = first;
+                first = needle == last ? NULL : lr_cell_next(lr, needle);
+                lr_cell_link(lr, needle, cell);
+            }
+            while(cell) {
+                needle = cell;
+                cell = lr_cell_next(lr, needle);
+                lr_cell_release(lr, needle);
+            }
+            lr_owner_abandon(lr, owner_cell);
+            unlock_and_return(lr, owner, LR_ERROR_BUFFER_FULL);
+        }
+        lr_cell_data(lr, cell) = buf[idx];
+        lr_cell_stamp(lr, cell, now);
+
+        if(last) {
+            lr_cell_link(lr, last, cell);
+        } else {
+            first = cell;
+        }
+        last = cell;
+    }
+
+    lr_owner_append(lr, owner_cell, first, last);
+
+    lr->count += len;
+    if(slot)
+        slot->count += len;
+    lr_count_add(lr, owner, len);
+    lr_wait_signal_owner(lr, owner);
+
+    unlock_and_return(lr, owner, LR_OK);
+}
+
+/**
+ * Add a new string element to the linked ring buffer.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * @param data: the string to be added to the buffer
+ * @param owner: the owner of the new element
+ * 
+ * @return LR_OK: if the element was successfully added
+ *         LR_ERROR_BUFFER_FULL: if the buffer is full and the element could
+ *                               not be added, the buffer is left untouched
+ */
+lr_result_t lr_put_string(struct linked_ring *lr, unsigned char *data,
+                           lr_owner_t owner)
+{
+    return lr_put_bytes(lr, data, strlen((char *) data), owner);
+}
+
+/**
+ * Append bytes to the stream of the owner. Bytes are packed into cells,
+ * up to LR_CELL_BYTES per cell, and the last cell of the stream is topped up
+ * first. The owner should not be used with lr_put() at the same time.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param buf: pointer to the bytes to be written
+ * @param len: number of bytes
+ * @param owner: the owner of the stream
+ *
+ * @return number of bytes written, less than len if the buffer is full
+ */
+size_t lr_write(struct linked_ring *lr, const unsigned char *buf, size_t len,
+                lr_owner_t owner)
+{
+    struct lr_cell *first;
+    struct lr_cell *last;
+    struct lr_cell *cell;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    lr_data_t word;
+    size_t written;
+    size_t fill;
+    size_t cells_nr;
+    size_t room;
+#if defined(LR_CELL_TIME)
+    lr_time_t now;
+#endif
+
+    if(len == 0) {
+        return 0;
+    }
+
+    lock_or_return(lr, owner, 0);
+#if defined(LR_CELL_TIME)
+    now = lr_now(lr);
+#endif
+
+    written = 0;
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    room = lr->quotas ? lr_quota_room(lr, owner, owner_cell == NULL) : lr->size;
+    if(owner_cell) {
+        /* Top up the last cell of the stream */
+        cell = lr_owner_tail(lr, owner_cell);
+        word = lr_cell_data(lr, cell);
+        for(fill = lr_bytes_fill(word); fill < LR_CELL_BYTES && written < len; fill++) {
+            word = lr_bytes_set(word, fill, buf[written++]);
+        }
+        lr_cell_data(lr, cell) = lr_bytes_refill(word, fill);
+    } else {
+        owner_cell = lr_owner_get(lr, owner, &slot);
+        if(owner_cell == NULL) {
+            unlock_and_count(lr, owner, written);
+        }
+    }
+
+    /* Pack the rest into the run of cells */
+    first = NULL;
+    last = NULL;
+    cells_nr = 0;
+    while(written < len && cells_nr < lr_available(lr) && cells_nr < room) {
+        cell = lr_cell_alloc(lr);
+        if(cell == NULL) {
+            /* Free cells are taken from the lock-free pool by others */
+            break;
+        }
+        word = 0;
+        for(fill = 0; fill < LR_CELL_BYTES && written < len; fill++) {
+            word = lr_bytes_set(word, fill, buf[written++]);
+        }
+        lr_cell_data(lr, cell) = lr_bytes_refill(word, fill);
+        lr_cell_stamp(lr, cell, now);
+
+        if(last) {
+            lr_cell_link(lr, last, cell);
+        } else {
+            first = cell;
+        }
+        last = cell;
+        cells_nr++;
+    }
+
+    if(first) {
+        lr_owner_append(lr, owner_cell, first, last);
+
+        lr->count += cells_nr;
+        if(slot)
+            slot->count += cells_nr;
+        lr_count_add(lr, owner, cells_nr);
+    } else {
+        lr_owner_abandon(lr, owner_cell);
+    }
+    if(written) {
+        lr_wait_signal_owner(lr, owner);
+    }
+
+    unlock_and_count(lr, owner, written);
+}
+
+/**
+ * Take the element from the head of the owner chain, sharing the ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: pointer to the location where the retrieved data will be stored
+ * @param owner: the owner of the element
+ *
+ * @return LR_OK: if the element was retrieved
+ *         LR_ERROR_BUFFER_EMPTY: if the owner has no elements
+ *         LR_ERROR_BUFFER_BUSY: if the ring should be locked to retire the
+ *                               owner with the last element
+ *         LR_ERROR_LOCK, LR_ERROR_UNLOCK: if the owner lock failed
+ */
+lr_result_t lr_get_shared(struct linked_ring *lr, lr_data_t *data,
+                          lr_owner_t owner)
+{
+    struct lr_cell *head;
+    struct lr_cell *prev_tail;
+    struct lr_cell *prev_owner;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    size_t link_lock;
+    size_t count;
+    lr_result_t result;
+
+    lr_shared_lock(lr);
+
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        lr_shared_unlock(lr);
+
+        return LR_ERROR_BUFFER_EMPTY;
+    }
+
+    if(owner_cell == lr_last_cell(lr)) {
+        prev_owner = lr->owners;
+    } else {
+        prev_owner = owner_cell + 1;
+    }
+
+    /* The link to the head belongs to the previous owner */
+    link_lock = lr_owner_lock_nr(lr, prev_owner);
+    result = lr->owner_lock(lr->owner_locks_state, link_lock);
+    if(result != LR_OK) {
+        lr_shared_unlock(lr);
+
+        return result;
+    }
+
+    prev_tail = lr_owner_tail(lr, prev_owner);
+    head = lr_cell_next(lr, prev_tail);
+    if(head == lr_owner_tail_acquire(lr, owner_cell)) {
+        result = lr->owner_unlock(lr->owner_locks_state, link_lock);
+        lr_shared_unlock(lr);
+
+        return result != LR_OK ? result : LR_ERROR_BUFFER_BUSY;
+    }
+
+    /* Head isn't the tail, so its link isn't changed by the producer */
+    lr_cell_link(lr, prev_tail, lr_cell_next(lr, head));
+
+    result = lr->owner_unlock(lr->owner_locks_state, link_lock);
+
+    *data = lr_cell_data(lr, head);
+    count = __atomic_fetch_sub(&lr->count, 1, __ATOMIC_RELAXED);
+    if(slot)
+        __atomic_sub_fetch(&slot->count, 1, __ATOMIC_RELAXED);
+
+#if defined(LR_POOL_LOCKFREE)
+    lr_cell_release_shared(lr, head,
+                           lr_full_count(lr, count) ? 0 : lr_spare_count(lr, count));
+#else
+    lr_cell_release_shared(lr, head, 0);
+#endif
+    lr_wait_signal_space(lr);
+    lr_event_space(lr, lr_full_count(lr, count));
+
+    lr_shared_unlock(lr);
+
+    return result;
+}
+
+/**
+ * Unlink the next element of the owner from the linked ring buffer locked by
+ * the caller. The cell of the element is left to the caller to release.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: pointer to the variable where the retrieved data will be stored
+ * @param owner: the owner of the retrieved element
+ * @param head: pointer to the variable where the unlinked cell will be stored
+ *
+ * @return LR_OK: if the element was successfully retrieved
+ *         LR_ERROR_BUFFER_EMPTY: if the buffer is empty and no element could be retrieved
+ */
+lr_result_t lr_get_locked(struct linked_ring *lr, lr_data_t *data, lr_owner_t owner,
+                          struct lr_cell **head)
+{
+    struct lr_cell *last_cell;
+    struct lr_cell *tail;
+    struct lr_cell *prev_owner;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        return LR_ERROR_BUFFER_EMPTY;
+    }
+
+    last_cell = lr_last_cell(lr);
+    if(owner_cell == last_cell) {
+        prev_owner = lr->owners;        
+    } else {
+        prev_owner = owner_cell + 1;        
+    }
+    *head = lr_cell_next(lr, lr_owner_tail(lr, prev_owner));
+    lr_cell_link(lr, lr_owner_tail(lr, prev_owner), lr_cell_next(lr, *head));
+
+    *data = lr_cell_data(lr, *head);
+    lr->count -= 1;
+    if(slot)
+        slot->count -= 1;
+    lr_count_sub(lr, owner, 1);
+
+    tail = lr_owner_tail(lr, owner_cell);
+    if(*head == tail) {
+        /* If last cell for owner, release the owner cell */
+        lr_owner_retire(lr, owner_cell);
+    }
+
+    return LR_OK;
+}
+
+/**
+ * Retrieve the next element from the linked ring buffer, without flat
+ * combining.
+ * 
+ * @param lr: pointer to the linked ring structure
+ * @param data: pointer to the variable where the retrieved data will be stored
+ * @param owner: the owner of the retrieved element
+ * 
+ * @return LR_OK: if the element was successfully retrieved
+ *         LR_ERROR_BUFFER_EMPTY: if the buffer is empty and no element could be retrieved
+ */
+lr_result_t lr_get_direct(struct linked_ring *lr, lr_data_t *data, lr_owner_t owner)
+{
+    struct lr_cell *head;
+    lr_result_t result;
+    int full;
+
+#if LR_LOCK == LR_LOCK_DYNAMIC
+    if(lr->owner_lock && !lr_counted(lr)) {
+        result = lr_get_shared(lr, data, owner);
+        if(result != LR_ERROR_BUFFER_BUSY) {
+            return result;
+        }
+    }
+#endif
+
+    lock(lr, owner);
+
+    full = lr_available(lr) == 0;
+    result = lr_get_locked(lr, data, owner, &head);
+    if(result != LR_OK) {
+        unlock_and_return(lr, owner, result);
+    }
+
+#if defined(LR_POOL_LOCKFREE)
+    /* The cell is pushed to the pool after the ring is unlocked, unless it
+     * extends the reserve */
+    if(lr_cell_reserve(lr, head)) {
+        lr_wait_signal_space(lr);
+        lr_event_space(lr, full);
+        unlock_and_return(lr, owner, LR_OK);
+    }
+
+    __atomic_add_fetch(&lr->taken, 1, __ATOMIC_RELAXED);
+    unlock_and_release(lr, owner, head, full, LR_OK);
+#else
+    lr_cell_release(lr, head);
+    lr_wait_signal_space(lr);
+    lr_event_space(lr, full);
+
+    unlock_and_return(lr, owner, LR_OK);
+#endif
+}
+
+/* Thread local mark, which address spreads threads over combining slots */
+static _Thread_local char lr_combine_mark;
+
+/**
+ * Set slots of flat combining. lr_put() and lr_get() publish the request in a
+ * free slot, and the thread, which takes the combiner lock, applies pending
+ * requests of all slots, while the rest wait for the result in their slots.
+ * The ring is changed by one thread at a time, so its cells and the mutex stay
+ * in the cache of that thread under heavy contention. If all slots are busy,
+ * the request is applied directly. It should be called before the ring is
+ * shared between threads.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param slots: pointer to the array of slots, NULL to disable combining
+ * @param slots_nr: number of slots, power of two, about the number of threads
+ *
+ * @return LR_OK: if the slots are set
+ *         LR_ERROR_NOMEMORY: if slots_nr isn't a power of two
+ *         LR_ERROR_LOCK: if the lock is fixed by LR_LOCK at build time
+ */
+lr_result_t lr_set_combining(struct linked_ring *lr,
+                             struct lr_combine_slot *slots, size_t slots_nr)
+{
+#if LR_LOCK != LR_LOCK_DYNAMIC
+    if(slots != NULL) {
+        return LR_ERROR_LOCK;
+    }
+#endif
+    if(slots != NULL) {
+        if(slots_nr == 0 || (slots_nr & (slots_nr - 1)) != 0) {
+            return LR_ERROR_NOMEMORY;
+        }
+
+        for(size_t idx = 0; idx < slots_nr; idx++) {
+            slots[idx].state = LR_COMBINE_FREE;
+        }
+    } else {
+        slots_nr = 0;
+    }
+
+    lr->combine_slots    = slots;
+    lr->combine_slots_nr = slots_nr;
+    lr->combine_lock     = 0;
+
+    return LR_OK;
+}
+
+/**
+ * Set the policy of lr_put() on the full ring. By default the new element
+ * isn't added. Otherwise the oldest element of the owner, of owners in turn,
+ * or of the owner with the most elements is dropped and its cell takes the
+ * new element, so producers don't fail on the full ring. Dropped elements
+ * are counted in dropped of the ring.
+ *
+ * LR_OVERFLOW_LONGEST keeps owners of the index in the max-heap by number of
+ * elements, so the owner is found in constant time and each put or get
+ * moves it in logarithmic time of number of owners. Elements are counted
+ * under the mutex then. Without the index owners are dropped in turn.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param policy: LR_OVERFLOW_FAIL, LR_OVERFLOW_OWNER, LR_OVERFLOW_RING or
+ *                LR_OVERFLOW_LONGEST
+ *
+ * @return LR_OK: if the policy is set
+ *         LR_ERROR_NOMEMORY: if LR_OVERFLOW_LONGEST is set without the index
+ *         LR_ERROR_UNKNOWN: if the policy is unknown
+ *         LR_ERROR_LOCK: if the lock is fixed by LR_LOCK at build time
+ */
+lr_result_t lr_set_overflow(struct linked_ring *lr, enum lr_overflow policy)
+{
+    if(policy != LR_OVERFLOW_FAIL && policy != LR_OVERFLOW_OWNER
+       && policy != LR_OVERFLOW_RING && policy != LR_OVERFLOW_LONGEST) {
+        return LR_ERROR_UNKNOWN;
+    }
+    if(policy == LR_OVERFLOW_LONGEST && lr->index == NULL) {
+        return LR_ERROR_NOMEMORY;
+    }
+#if LR_LOCK != LR_LOCK_DYNAMIC
+    if(policy != LR_OVERFLOW_FAIL) {
+        return LR_ERROR_LOCK;
+    }
+#endif
+
+    lr->overflow = policy;
+    if(lr_longest(lr)) {
+        lr_longest_build(lr);
+    }
+
+    return LR_OK;
+}
+
+/**
+ * Set the table of quotas of owners, quotas are cleared. It should be called
+ * before the ring is shared between threads.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param quotas: caller supplied array of slots, NULL to disable quotas
+ * @param quotas_nr: number of slots, power of two, more than the number of
+ *                   owners with quotas
+ *
+ * @return LR_OK: if the table is set
+ *         LR_ERROR_NOMEMORY: if quotas_nr isn't a power of two
+ *         LR_ERROR_LOCK: if the lock is fixed by LR_LOCK at build time
+ */
+lr_result_t lr_set_quotas(struct linked_ring *lr,
+                          struct lr_owner_quota *quotas, size_t quotas_nr)
+{
+#if LR_LOCK != LR_LOCK_DYNAMIC
+    if(quotas != NULL) {
+        return LR_ERROR_LOCK;
+    }
+#endif
+    if(quotas != NULL) {
+        if(quotas_nr == 0 || (quotas_nr & (quotas_nr - 1)) != 0) {
+            return LR_ERROR_NOMEMORY;
+        }
+
+        for(size_t idx = 0; idx < quotas_nr; idx++) {
+            quotas[idx].max   = 0;
+            quotas[idx].min   = 0;
+            quotas[idx].high  = 0;
+#if defined(LR_CELL_TIME)
+            quotas[idx].ttl   = 0;
+#endif
+            quotas[idx].count = 0;
+        }
+    } else {
+        quotas_nr = 0;
+    }
+
+    lr->quotas    = quotas;
+    lr->quotas_nr = quotas_nr;
+    lr->reserved  = 0;
+#if defined(LR_CELL_TIME)
+    lr->ttls      = 0;
+#endif
+
+    return LR_OK;
+}
+
+/**
+ * Find the quota slot of the owner, the new slot is taken if the owner has
+ * none. Elements of the owner are counted once, when the slot is taken.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ *
+ * @return pointer to the slot, NULL if the table is full
+ */
+struct lr_owner_quota* lr_quota_insert(struct linked_ring *lr, lr_owner_t owner)
+{
+    struct lr_owner_quota *quota;
+    struct lr_owner_slot *slot;
+    struct lr_cell *owner_cell;
+
+    quota = lr_quota_find(lr, owner);
+    if(quota && lr_quota_empty(quota)) {
+        owner_cell   = lr_owner_find(lr, owner, &slot);
+        quota->owner = owner;
+        quota->count = owner_cell ? lr_owner_length(lr, owner_cell, 0) : 0;
+        quota->above = 0;
+    }
+
+    return quota;
+}
+
+/**
+ * Release the quota slot whose limits and watermarks aren't set. Following
+ * slots of the probe sequence are shifted back, so the table never keeps
+ * tombstones.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param hole: pointer to the empty slot
+ */
+void lr_quota_remove(struct linked_ring *lr, struct lr_owner_quota *hole)
+{
+    struct lr_owner_quota *quota;
+    size_t mask;
+    size_t home;
+    size_t hole_idx;
+    size_t idx;
+
+    mask     = lr->quotas_nr - 1;
+    hole_idx = hole - lr->quotas;
+    idx      = hole_idx;
+    while(1) {
+        idx   = (idx + 1) & mask;
+        quota = &lr->quotas[idx];
+        if(lr_quota_empty(quota)) {
+            break;
+        }
+
+        /* Move the slot into the hole if its home isn't between hole and slot */
+        home = lr_quota_hash(lr, quota->owner);
+        if(((idx - home) & mask) >= ((idx - hole_idx) & mask)) {
+            lr->quotas[hole_idx] = *quota;
+            *quota               = (struct lr_owner_quota) {0};
+            hole_idx             = idx;
+        }
+    }
+}
+
+/**
+ * Set the quota of the owner. The owner doesn't add elements above the
+ * maximum, and free cells up to the minimum of each owner are kept for it,
+ * even if it has no elements, so a noisy owner doesn't starve the others.
+ * lr_put(), lr_put_many(), lr_put_bytes() and lr_write() check the quota in
+ * constant time, with the number of elements counted in the slot. Operations
+ * of owners with quotas take the mutex even if owner locks are set.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ * @param min: number of elements reserved for the owner
+ * @param max: number of elements of the owner at most, 0 if not limited
+ *
+ * @return LR_OK: if the quota is set, or removed if both limits are 0
+ *         LR_ERROR_NOMEMORY: if the table isn't set or it's full, or the
+ *                            minimum exceeds the maximum
+ */
+lr_result_t lr_set_quota(struct linked_ring *lr, lr_owner_t owner, size_t min,
+                         size_t max)
+{
+    struct lr_owner_quota *quota;
+
+    if(lr->quotas == NULL || (max && min > max)) {
+        return LR_ERROR_NOMEMORY;
+    }
+
+    lock(lr, owner);
+
+    quota = lr_quota_find(lr, owner);
+    if(quota == NULL || (lr_quota_empty(quota) && min == 0 && max == 0)) {
+        unlock_and_return(lr, owner, quota || min || max ? LR_ERROR_NOMEMORY : LR_OK);
+    }
+
+    quota = lr_quota_insert(lr, owner);
+    lr->reserved -= lr_quota_unmet(quota);
+    quota->min = min;
+    quota->max = max;
+    lr->reserved += lr_quota_unmet(quota);
+    if(lr_quota_empty(quota)) {
+        lr_quota_remove(lr, quota);
+    }
+
+    unlock_and_return(lr, owner, LR_OK);
+}
+
+/**
+ * Set watermarks of elements in the ring. When lr_put() makes the number of
+ * elements reach the high watermark, the ring is marked above it and the
+ * callback is called; when lr_get() makes it drop to the low watermark, the
+ * mark is cleared and the callback is called again. The gap between them
+ * keeps producers from flapping around one level. Elements are counted under
+ * the mutex, so lr_put() and lr_get() don't take the shared owner lock path.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param low: low watermark, less than the high one
+ * @param high: high watermark, 0 to disable watermarks of the ring
+ *
+ * @return LR_OK: if watermarks are set
+ *         LR_ERROR_UNKNOWN: if the low watermark isn't less than the high one
+ */
+lr_result_t lr_set_watermarks(struct linked_ring *lr, size_t low, size_t high)
+{
+    if(high && low >= high) {
+        return LR_ERROR_UNKNOWN;
+    }
+
+    lock(lr, 0);
+
+    lr->low  = low;
+    lr->high = high;
+    __atomic_store_n(&lr->above, high && lr->count >= high, __ATOMIC_RELAXED);
+
+    unlock_and_return(lr, 0, LR_OK);
+}
+
+/**
+ * Set watermarks of the owner, which are kept in the table of quotas. The
+ * owner is marked above the high watermark and the callback is called the
+ * same way as for the ring, see lr_set_watermarks().
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ * @param low: low watermark, less than the high one
+ * @param high: high watermark, 0 to disable watermarks of the owner
+ *
+ * @return LR_OK: if watermarks are set
+ *         LR_ERROR_NOMEMORY: if the table isn't set or it's full
+ *         LR_ERROR_UNKNOWN: if the low watermark isn't less than the high one
+ */
+lr_result_t lr_set_owner_watermarks(struct linked_ring *lr, lr_owner_t owner,
+                                    size_t low, size_t high)
+{
+    struct lr_owner_quota *quota;
+
+    if(high && low >= high) {
+        return LR_ERROR_UNKNOWN;
+    }
+    if(lr->quotas == NULL) {
+        return LR_ERROR_NOMEMORY;
+    }
+
+    lock(lr, owner);
+
+    quota = lr_quota_find(lr, owner);
+    if(quota == NULL || (lr_quota_empty(quota) && high == 0)) {
+        unlock_and_return(lr, owner, quota || high ? LR_ERROR_NOMEMORY : LR_OK);
+    }
+
+    quota = lr_quota_insert(lr, owner);
+    quota->low  = low;
+    quota->high = high;
+    __atomic_store_n(&quota->above, high && quota->count >= high, __ATOMIC_RELAXED);
+    if(lr_quota_empty(quota)) {
+        lr_quota_remove(lr, quota);
+    }
+
+    unlock_and_return(lr, owner, LR_OK);
+}
+
+/**
+ * Set the callback of watermark crossings. It's called under the mutex by
+ * the operation that crossed the watermark, with the owner of the operation,
+ * so it shouldn't call operations of the ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param watermark: the callback, NULL to only mark crossings
+ * @param state: pointer passed to the callback
+ *
+ * @return LR_OK
+ */
+lr_result_t lr_set_watermark_callback(
+    struct linked_ring *lr,
+    void (*watermark)(void *state, lr_owner_t owner, enum lr_watermark crossing),
+    void *state)
+{
+    lr->watermark       = watermark;
+    lr->watermark_state = state;
+
+    return LR_OK;
+}
+
+/**
+ * Check whether the owner is above its high watermark, it could be polled by
+ * producers without the callback.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ *
+ * @return 1 if the owner reached the high watermark and didn't drop to the
+ *         low one yet, 0 otherwise
+ */
+int lr_owner_above(struct linked_ring *lr, lr_owner_t owner)
+{
+    struct lr_owner_quota *quota;
+    int above;
+
+    if(lr->quotas == NULL) {
+        return 0;
+    }
+
+    lock_or_return(lr, owner, 0);
+
+    quota = lr_quota_find(lr, owner);
+    above = quota && !lr_quota_empty(quota) && quota->above;
+
+    unlock_and_count(lr, owner, above);
+}
+
+#if defined(LR_CELL_TIME)
+/**
+ * Milliseconds of the monotonic clock, the default clock of the ring.
+ *
+ * @param state: unused
+ *
+ * @return current time in milliseconds
+ */
+lr_time_t lr_clock_monotonic(void *state)
+{
+    struct timespec now;
+
+    (void) state;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (lr_time_t) now.tv_sec * 1000 + (lr_time_t) now.tv_nsec / 1000000;
+}
+
+/**
+ * Set the clock which stamps added elements. TTLs and the time passed to
+ * lr_expire() are measured with it. It should be called before the ring is
+ * shared between threads.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param clock: the clock, NULL for lr_clock_monotonic()
+ * @param state: pointer passed to the clock
+ *
+ * @return LR_OK
+ */
+lr_result_t lr_set_clock(struct linked_ring *lr,
+                         lr_time_t (*clock)(void *state), void *state)
+{
+    lr->clock       = clock ? clock : lr_clock_monotonic;
+    lr->clock_state = state;
+
+    return LR_OK;
+}
+
+/**
+ * Set TTL of elements in the ring. Elements that stay in the ring for the
+ * TTL are expired by lr_expire(), or by lr_put() when free cells run out, so
+ * elements of dead consumers don't hold the cells. Elements are expired under
+ * the mutex, so lr_put() and lr_get() don't take the shared owner lock path.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param ttl: TTL in units of the clock, 0 if elements don't expire
+ *
+ * @return LR_OK: if TTL is set
+ *         LR_ERROR_LOCK: if the lock is fixed by LR_LOCK at build time
+ */
+lr_result_t lr_set_ttl(struct linked_ring *lr, lr_time_t ttl)
+{
+#if LR_LOCK != LR_LOCK_DYNAMIC
+    if(ttl != 0) {
+        return LR_ERROR_LOCK;
+    }
+#endif
+
+    lock(lr, 0);
+
+    lr->ttl = ttl;
+
+    unlock_and_return(lr, 0, LR_OK);
+}
+
+/**
+ * Set TTL of elements of the owner, which is kept in the table of quotas and
+ * overrides TTL of the ring, see lr_set_ttl().
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner
+ * @param ttl: TTL in units of the clock, 0 to use TTL of the ring
+ *
+ * @return LR_OK: if TTL is set
+ *         LR_ERROR_NOMEMORY: if the table isn't set or it's full
+ */
+lr_result_t lr_set_owner_ttl(struct linked_ring *lr, lr_owner_t owner,
+                             lr_time_t ttl)
+{
+    struct lr_owner_quota *quota;
+
+    if(lr->quotas == NULL) {
+        return LR_ERROR_NOMEMORY;
+    }
+
+    lock(lr, owner);
+
+    quota = lr_quota_find(lr, owner);
+    if(quota == NULL || (lr_quota_empty(quota) && ttl == 0)) {
+        unlock_and_return(lr, owner, quota || ttl ? LR_ERROR_NOMEMORY : LR_OK);
+    }
+
+    quota = lr_quota_insert(lr, owner);
+    lr->ttls -= quota->ttl != 0;
+    quota->ttl = ttl;
+    lr->ttls += quota->ttl != 0;
+    if(lr_quota_empty(quota)) {
+        lr_quota_remove(lr, quota);
+    }
+
+    unlock_and_return(lr, owner, LR_OK);
+}
+
+/**
+ * Expire elements that stayed in the ring for TTL of their owner. Owners are
+ * checked in turn from the oldest element, and no more than budget cells are
+ * checked, so the ring is locked for bounded time and the call could be
+ * repeated from a timer or an idle loop. Expired elements are counted in
+ * expired of the ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param now: current time of the clock of the ring
+ * @param budget: number of cells to check
+ *
+ * @return number of expired elements
+ */
+size_t lr_expire(struct linked_ring *lr, lr_time_t now, size_t budget)
+{
+    size_t expired;
+    int full;
+
+    if(budget == 0) {
+        return 0;
+    }
+
+    lock_or_return(lr, 0, 0);
+
+    if(!lr_expiring(lr)) {
+        unlock_and_count(lr, 0, 0);
+    }
+
+    full = lr_available(lr) == 0;
+    expired = lr_expire_some(lr, now, budget);
+    if(expired) {
+        lr_wait_signal_space(lr);
+        lr_event_space(lr, full);
+    }
+
+    unlock_and_count(lr, 0, expired);
+}
+#endif
+
+/**
+ * Apply pending requests of all slots. Called by the thread holding the
+ * combiner lock. The ring is locked once for each pass over the slots.
+ *
+ * @param lr: pointer to the linked ring structure
+ */
+void lr_combine_apply(struct linked_ring *lr)
+{
+    struct lr_combine_slot *slot;
+    struct lr_cell *head;
+    lr_result_t locked;
+    size_t applied = 2;
+    int full;
+
+    for(size_t pass = 0; pass < LR_COMBINE_PASSES && applied > 1; pass++) {
+        applied = 0;
+        locked = LR_OK;
+        for(size_t idx = 0; idx < lr->combine_slots_nr; idx++) {
+            slot = &lr->combine_slots[idx];
+            if(__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != LR_COMBINE_PENDING) {
+                continue;
+            }
+
+            if(applied == 0) {
+                /* Requests fail with the result of the lock if it fails */
+                locked = lr_mutex_lock(lr, 0);
+            }
+
+            if(locked != LR_OK) {
+                slot->result = locked;
+            } else if(slot->op == LR_COMBINE_PUT) {
+                slot->result = lr_put_locked(lr, slot->data, slot->owner, NULL);
+            } else {
+                full = lr_available(lr) == 0;
+                slot->result = lr_get_locked(lr, &slot->data, slot->owner, &head);
+                if(slot->result == LR_OK) {
+                    lr_cell_release(lr, head);
+                    lr_wait_signal_space(lr);
+                    lr_event_space(lr, full);
+                }
+            }
+
+            __atomic_store_n(&slot->state, LR_COMBINE_DONE, __ATOMIC_RELEASE);
+            applied++;
+        }
+
+        if(applied && locked == LR_OK) {
+            (void) lr_mutex_unlock(lr, 0);
+        }
+    }
+}
+
+/**
+ * Publish the request in the combining slot and wait until it's applied by
+ * the combiner, or become the combiner.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param op: LR_COMBINE_PUT or LR_COMBINE_GET
+ * @param data: data to put, or the variable where the data will be stored
+ * @param owner: the owner of the element
+ *
+ * @return result of lr_put_direct() or lr_get_direct()
+ */
+lr_result_t lr_combine(struct linked_ring *lr, lr_lock_t op, lr_data_t *data,
+                       lr_owner_t owner)
+{
+    struct lr_combine_slot *slot = NULL;
+    struct lr_combine_slot *candidate;
+    size_t mask = lr->combine_slots_nr - 1;
+    size_t start;
+    lr_lock_t state;
+    lr_result_t result;
+    unsigned int spins = 0;
+
+    start = (size_t) (((uint64_t) (uintptr_t) &lr_combine_mark
+                       * 0x9E3779B97F4A7C15ULL) >> 32);
+    for(size_t idx = 0; idx <= mask; idx++) {
+        candidate = &lr->combine_slots[(start + idx) & mask];
+        state = LR_COMBINE_FREE;
+        if(__atomic_load_n(&candidate->state, __ATOMIC_RELAXED) == LR_COMBINE_FREE
+           && __atomic_compare_exchange_n(&candidate->state, &state,
+                                          LR_COMBINE_CLAIMED, 0,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            slot = candidate;
+            break;
+        }
+    }
+
+    if(slot == NULL) {
+        return op == LR_COMBINE_PUT ? lr_put_direct(lr, *data, owner)
+                                    : lr_get_direct(lr, data, owner);
+    }
+
+    slot->op    = op;
+    slot->owner = owner;
+    if(op == LR_COMBINE_PUT) {
+        slot->data = *data;
+    }
+    __atomic_store_n(&slot->state, LR_COMBINE_PENDING, __ATOMIC_RELEASE);
+
+    while(__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) != LR_COMBINE_DONE) {
+        if(__atomic_load_n(&lr->combine_lock, __ATOMIC_RELAXED) == 0
+           && __atomic_exchange_n(&lr->combine_lock, 1, __ATOMIC_ACQUIRE) == 0) {
+            lr_combine_apply(lr);
+            __atomic_store_n(&lr->combine_lock, 0, __ATOMIC_RELEASE);
+        } else {
+            lr_spin_relax(spins);
+        }
+    }
+
+    if(op == LR_COMBINE_GET) {
+        *data = slot->data;
+    }
+    result = slot->result;
+    __atomic_store_n(&slot->state, LR_COMBINE_FREE, __ATOMIC_RELEASE);
+
+    return result;
+}
+
+/**
+ * Add a new element to the linked ring buffer. The request is combined with
+ * requests of other threads, if slots are set with lr_set_combining().
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: the data to be added to the buffer
+ * @param owner: the owner of the new element
+ *
+ * @return LR_OK: if the element was successfully added
+ *         LR_ERROR_BUFFER_FULL: if the buffer is full and the element could not be added
+ */
+lr_result_t lr_put(struct linked_ring *lr, lr_data_t data, lr_owner_t owner)
+{
+#if LR_LOCK == LR_LOCK_DYNAMIC
+    if(lr->combine_slots != NULL) {
+        return lr_combine(lr, LR_COMBINE_PUT, &data, owner);
+    }
+#endif
+
+    return lr_put_direct(lr, data, owner);
+}
+
+/**
+ * Retrieve the next element from the linked ring buffer. The request is
+ * combined with requests of other threads, if slots are set with
+ * lr_set_combining().
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: pointer to the variable where the retrieved data will be stored
+ * @param owner: the owner of the retrieved element
+ *
+ * @return LR_OK: if the element was successfully retrieved
+ *         LR_ERROR_BUFFER_EMPTY: if the buffer is empty and no element could be retrieved
+ */
+lr_result_t lr_get(struct linked_ring *lr, lr_data_t *data, lr_owner_t owner)
+{
+#if LR_LOCK == LR_LOCK_DYNAMIC
+    if(lr->combine_slots != NULL) {
+        return lr_combine(lr, LR_COMBINE_GET, data, owner);
+    }
+#endif
+
+    return lr_get_direct(lr, data, owner);
+}
+
+/**
+ * Retrieve elements of the owner from the linked ring buffer. The owner is
+ * resolved and the elements are unlinked from its chain under a single lock.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param dst: pointer to the array where the retrieved data will be stored
+ * @param max: maximum number of elements to be retrieved
+ * @param owner: the owner of the retrieved elements
+ *
+ * @return the number of retrieved elements
+ */
+size_t lr_get_many(struct linked_ring *lr, lr_data_t *dst, size_t max,
+                   lr_owner_t owner)
+{
+    struct lr_cell *needle;
+    struct lr_cell *next;
+    struct lr_cell *tail;
+    struct lr_cell *prev_tail;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    size_t got;
+    int full;
+
+    if(max == 0) {
+        return 0;
+    }
+
+    lock_or_return(lr, owner, 0);
+
+    got = 0;
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        unlock_and_count(lr, owner, got);
+    }
+    full = lr_available(lr) == 0;
+
+    if(owner_cell == lr_last_cell(lr)) {
+        prev_tail = lr_owner_tail(lr, lr->owners);
+    } else {
+        prev_tail = lr_owner_tail(lr, owner_cell + 1);
+    }
+    tail = lr_owner_tail(lr, owner_cell);
+
+    /* Copy and release the cells from the head of the chain */
+    needle = lr_cell_next(lr, prev_tail);
+    do {
+        dst[got++] = lr_cell_data(lr, needle);
+        next = lr_cell_next(lr, needle);
+        lr_cell_release(lr, needle);
+    } while(needle != tail && got < max && (needle = next));
+
+    lr->count -= got;
+    if(slot)
+        slot->count -= got;
+    lr_count_sub(lr, owner, got);
+
+    /* Unlink the run, unless the ring of the only owner became empty */
+    if(prev_tail != tail || needle != tail) {
+        lr_cell_link(lr, prev_tail, next);
+    }
+
+    if(needle == tail) {
+        /* The chain is empty, release the owner cell */
+        lr_owner_retire(lr, owner_cell);
+    }
+    lr_wait_signal_space(lr);
+    lr_event_space(lr, full);
+
+    unlock_and_count(lr, owner, got);
+}
+
+/**
+ * Read bytes from the stream of the owner written with lr_write(). Cells are
+ * released when all their bytes are read, the rest of a partially read cell
+ * stays at the head of the stream.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param buf: pointer to the destination
+ * @param max: maximum number of bytes to read
+ * @param owner: the owner of the stream
+ *
+ * @return number of bytes read, 0 if the owner has no data
+ */
+size_t lr_read(struct linked_ring *lr, unsigned char *buf, size_t max,
+               lr_owner_t owner)
+{
+    struct lr_cell *needle;
+    struct lr_cell *next;
+    struct lr_cell *tail;
+    struct lr_cell *prev_tail;
+    struct lr_cell *owner_cell;
+    struct lr_owner_slot *slot;
+    lr_data_t word;
+    size_t got;
+    size_t fill;
+    size_t take;
+    size_t released;
+    int full;
+
+    if(max == 0) {
+        return 0;
+    }
+
+    lock_or_return(lr, owner, 0);
+
+    got = 0;
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        unlock_and_count(lr, owner, got);
+    }
+    full = lr_available(lr) == 0;
+
+    if(owner_cell == lr_last_cell(lr)) {
+        prev_tail = lr_owner_tail(lr, lr->owners);
+    } else {
+        prev_tail = lr_owner_tail(lr, owner_cell + 1);
+    }
+    tail = lr_owner_tail(lr, owner_cell);
+
+    /* Copy bytes from the head of the chain, releasing emptied cells. Needle
+     * ends at the new head, NULL if the chain is empty */
+    released = 0;
+    needle = lr_cell_next(lr, prev_tail);
+    next = NULL;
+    while(got < max) {
+        word = lr_cell_data(lr, needle);
+        fill = lr_bytes_fill(word);
+        take = fill < max - got ? fill : max - got;
+        for(size_t idx = 0; idx < take; idx++) {
+            buf[got++] = lr_bytes_byte(word, idx);
+        }
+
+        if(take < fill) {
+            /* Keep the rest of the cell at the head */
+            lr_cell_data(lr, needle) = lr_bytes_drop(word, take);
+            break;
+        }
+
+        next = lr_cell_next(lr, needle);
+        lr_cell_release(lr, needle);
+        released++;
+        if(needle == tail) {
+            needle = NULL;
+            break;
+        }
+        needle = next;
+    }
+
+    if(released == 0) {
+        unlock_and_count(lr, owner, got);
+    }
+
+    lr->count -= released;
+    if(slot)
+        slot->count -= released;
+    lr_count_sub(lr, owner, released);
+
+    if(needle == NULL) {
+        /* The chain is empty, unlink it unless it was the only owner */
+        if(prev_tail != tail) {
+            lr_cell_link(lr, prev_tail, next);
+        }
+        lr_owner_retire(lr, owner_cell);
+    } else {
+        lr_cell_link(lr, prev_tail, needle);
+    }
+    lr_wait_signal_space(lr);
+    lr_event_space(lr, full);
+
+    unlock_and_count(lr, owner, got);
+}
+
+/**
+ * Remove all elements of the owner at once. The chain of the owner is
+ * unhooked from the ring and spliced into the free cells in constant time,
+ * the callback, if provided, visits the elements from head to tail before
+ * that. The callback is called with the buffer locked.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param owner: the owner of the elements
+ * @param callback: function called with the state and data of every element,
+ *                  no op if NULL
+ * @param state: state passed to the callback
+ *
+ * @return number of removed elements, 0 if the owner has no data
+ */
+size_t lr_drain(struct linked_ring *lr, lr_owner_t owner,
+                void (*callback)(void *state, lr_data_t data), void *state)
+{
+    struct lr_cell *needle;
+    struct lr_cell *head;
+    struct lr_cell *tail;
+    struct lr_cell *prev_tail;
+    struct lr_cell *owner_cell;
+    struct lr_cell *pinned;
+    struct lr_cell *prev;
+    struct lr_owner_slot *slot;
+    size_t drained;
+    int full;
+
+    lock_or_return(lr, owner, 0);
+
+    drained = 0;
+    owner_cell = lr_owner_find(lr, owner, &slot);
+    if(owner_cell == NULL) {
+        unlock_and_count(lr, owner, drained);
+    }
+    full = lr_available(lr) == 0;
+
+    if(owner_cell == lr_last_cell(lr)) {
+        prev_tail = lr_owner_tail(lr, lr->owners);
+    } else {
+        prev_tail = lr_owner_tail(lr, owner_cell + 1);
+    }
+    tail = lr_owner_tail(lr, owner_cell);
+    head = lr_cell_next(lr, prev_tail);
 
-/* Unlock the mutex if unlock function provided and then return ret  */
-#define unlock_and_return(lr, ret) do { \
-    if (lr->unlock != NULL) { \
-        return lr->unlock(lr->mutex_state); \
-    } \
-    return ret; \
-} while (0)
+    if(callback) {
+        needle = head;
+        do {
+            callback(state, lr_cell_data(lr, needle));
+            drained++;
+        } while(needle != tail && (needle = lr_cell_next(lr, needle)));
+    } else if(slot) {
+        drained = slot->count;
+    } else {
+        drained = lr_owner_length(lr, owner_cell, 0);
+    }
 
-/* Additional overload for returning success */
-#define unlock_and_succeed(lr) unlock_and_return(lr, LR_OK)
+    /* The pinned cell of the owner returns to the reserve */
+    pinned = NULL;
+    prev   = NULL;
+    if(lr_pinned(lr) && lr->pinned_owner == owner_cell) {
+        pinned = lr->pinned;
+        prev = lr_pinned_prev(lr);
+    }
 
+    /* Unhook the chain, unless the ring of the only owner becomes empty */
+    if(prev_tail != tail) {
+        lr_cell_link(lr, prev_tail, lr_cell_next(lr, tail));
+    }
 
-struct lr_cell* lr_owner_find(struct linked_ring *lr, lr_data_t owner) {
-    /* Traverse through each owner in the owner array */
-    for (struct lr_cell *owner_cell = lr->owners; owner_cell < lr->owners + lr_owners_count(lr); owner_cell++) {
-        /* Check if owner of the current cell matches with given owner */
-        if (owner_cell->data == owner) {
-            return owner_cell;
+    if(pinned == head) {
+        head = pinned == tail ? NULL : lr_cell_next(lr, pinned);
+    } else if(pinned) {
+        lr_cell_link(lr, prev, lr_cell_next(lr, pinned));
+        if(pinned == tail) {
+            tail = prev;
         }
     }
 
-    return NULL;
-}
-
-struct lr_cell* lr_owner_head(struct linked_ring *lr, struct lr_cell *owner_cell) {
-    struct lr_cell *head;
-    struct lr_cell *prev_owner;
+    /* Chain is already linked from head to tail, splice it into free cells */
+    if(head) {
+        lr_pool_push(lr, head, tail);
+    }
 
-    if(owner_cell == lr_last_cell(lr)) {
-        /* If the provided owner is first, then last added owner is used 
-         * to link with owner_cell head 
-         */
-        head = lr->owners->next->next;
-    } else {
-        /* For any other cell, the prev owner is used for head linkage */
-        prev_owner = owner_cell + 1;  /* Owners stored in reverse oreder */
-        head = prev_owner->next->next;
+    lr->count -= drained;
+    lr_count_sub(lr, owner, drained);
+    lr_owner_retire(lr, owner_cell);
+    if(pinned) {
+        lr_cell_release(lr, pinned);
     }
-    
-    return head;
-}
+    lr_wait_signal_space(lr);
+    lr_event_space(lr, full);
 
-#define lr_owner_tail(owner_cell) owner_cell->next;
+    unlock_and_count(lr, owner, drained);
+}
 
+#if !defined(LR_CELL_INDEX_BITS)
 /**
- * Swap the provided cell with the cell at the write position in the linked ring buffer.
- * 
- * @param lr: pointer to the linked ring structure
- * @param cell: pointer to the cell to be swapped
- * 
- * @return pointer to the swapped cell
+ * Lend free cells of one ring to another. Cells are taken from the pool or
+ * from the bottom of the reserve of the lender and pushed to the pool of the
+ * borrower, which links them to its chains like its own cells. Cells of the
+ * last keep positions are kept for owners of the lender. Rings lock in turn,
+ * so rings lending to each other don't deadlock.
+ *
+ * @param from: pointer to the lending linked ring
+ * @param to: pointer to the borrowing linked ring
+ * @param nr: maximum number of cells to lend
+ * @param keep: number of cells at the end of the lender, which aren't lent
+ *
+ * @return number of lent cells
  */
-struct lr_cell* lr_cell_swap(struct linked_ring *lr, struct lr_cell *cell) {
-    struct lr_cell *swap;
-    struct lr_cell *last_free;
+size_t lr_lend(struct linked_ring *from, struct linked_ring *to, size_t nr,
+               size_t keep)
+{
+    struct lr_cell *limit = from->cells + from->size - keep;
+    struct lr_cell *first = NULL;
+    struct lr_cell *last  = NULL;
+    struct lr_cell *kept  = NULL;
+    struct lr_cell *cell;
+    size_t lent = 0;
 
-    /* Store the cell at the write position in the swap variable */
-    swap = lr->write;
+    lock_or_return(from, 0, 0);
 
-    /* Update the write position to the next cell */
-    if (swap->next) {
-        lr->write = swap->next; 
-    } else if (swap->next == NULL) {
-        lr->write = NULL;
+    while(lent < nr && (cell = lr_cell_alloc(from)) != NULL) {
+        if(cell >= limit && cell < from->cells + from->size) {
+            lr_cell_link(from, cell, kept);
+            kept = cell;
+            continue;
+        }
+
+        lr_cell_link(from, cell, first);
+        first = cell;
+        if(last == NULL) {
+            last = cell;
+        }
+        lent++;
     }
 
-    /* Copy the data and next pointer from the provided cell to the swap cell */
-    swap->data = cell->data;
-    swap->next = cell->next;
+    /* Kept cells are released in reverse order, so the reserve is restored */
+    while(kept) {
+        cell = kept;
+        kept = lr_cell_next(from, cell);
+        lr_cell_release(from, cell);
+    }
 
-    /* Update the next pointer of the owners pointing to the provided cell to point to the swap cell */
-    for (struct lr_cell *owner_swap = lr->owners; owner_swap < (lr->cells + lr->size); owner_swap++) {
-        if (owner_swap->next == cell) {
-            owner_swap->next = swap;
-        }
+    /* Lent cells aren't appended to chains of the lender */
+    if(from->pinned_owner == NULL) {
+        from->pinned = NULL;
     }
 
-    return swap;
+    from->borrowed -= (int) lent;
+    (void) lr_mutex_unlock(from, 0);
+
+    if(lent == 0) {
+        return 0;
+    }
+
+    if(lr_mutex_lock(to, 0) != LR_OK) {
+        /* Return the cells to the lender */
+        lock_or_return(from, 0, 0);
+        lr_pool_push(from, first, last);
+        from->borrowed += (int) lent;
+        unlock_and_count(from, 0, 0);
+    }
+
+    lr_pool_push(to, first, last);
+    to->borrowed += (int) lent;
+    lr_wait_signal_space(to);
+    unlock_and_count(to, 0, lent);
 }
+#else
+size_t lr_lend(struct linked_ring *from, struct linked_ring *to, size_t nr,
+               size_t keep)
+{
+    /* Indexes don't reach cells of other rings */
+    (void) from;
+    (void) to;
+    (void) nr;
+    (void) keep;
 
+    return 0;
+}
+#endif
 
-/* Lookup a cell in the linked ring buffer starting from the provided head cell.
- * If the cell is found, it is swapped with the cell at the write position and the head cell is updated accordingly.
- * 
- * @param lr: pointer to the linked ring structure
- * @param head: pointer to the head cell from where the lookup should start
- * @param cell: pointer to the cell to be looked up
- * 
- * @return pointer to the looked up cell if found, NULL otherwise
+/**
+ * Split cells between shards, linked rings, each with its own segment of the
+ * cells array. Owners are hashed to shards, so operations of owners in
+ * different shards don't share the lock, and the shard without free cells
+ * borrows them from neighbours. Locks of shards are set with lr_set_mutex()
+ * on each of them.
+ *
+ * @param sr: pointer to the sharded linked ring
+ * @param shards: pointer to the array of shards
+ * @param shards_nr: number of shards, power of two
+ * @param size: number of cells in the array
+ * @param cells: pointer to the array of cells
+ * @param owners_nr: number of owners in each shard, whose cells aren't lent
+ *
+ * @return LR_OK: if the shards are initialized
+ *         LR_ERROR_NOMEMORY: if shards_nr isn't a power of two, or shards
+ *                            don't get more than owners_nr cells
  */
-struct lr_cell* lr_cell_lookup(struct linked_ring *lr, struct lr_cell *head, struct lr_cell *cell) {
-    struct lr_cell *swap;
-    struct lr_cell *needle;
+#if defined(LR_CELL_SOA)
+lr_result_t lr_sharded_init_soa(struct lr_sharded *sr,
+                                struct linked_ring *shards, size_t shards_nr,
+                                size_t size, struct lr_cell *cells,
+                                lr_data_t *payload, size_t owners_nr)
+#else
+lr_result_t lr_sharded_init(struct lr_sharded *sr, struct linked_ring *shards,
+                            size_t shards_nr, size_t size,
+                            struct lr_cell *cells, size_t owners_nr)
+#endif
+{
+    size_t segment;
+    lr_result_t result;
 
-    /* Traverse through the linked ring buffer starting from the head cell */
-    needle = head;
-    while(needle->next != head && needle->next != cell) {
-        needle = needle->next;
+    if(shards == NULL || shards_nr == 0 || (shards_nr & (shards_nr - 1)) != 0
+       || owners_nr == 0) {
+        return LR_ERROR_NOMEMORY;
     }
 
-    /* If the cell is found, swap it with the cell at the write position and update the head cell */
-    if(needle->next == cell) {
-        swap = lr_cell_swap(lr, cell);
-        needle->next = swap;
+    segment = size / shards_nr;
+    if(segment <= owners_nr) {
+        return LR_ERROR_NOMEMORY;
+    }
 
-        return cell;
+    for(size_t idx = 0; idx < shards_nr; idx++) {
+#if defined(LR_CELL_SOA)
+        result = lr_init_soa(&shards[idx], segment, cells + idx * segment,
+                             payload + idx * segment);
+#else
+        result = lr_init(&shards[idx], segment, cells + idx * segment);
+#endif
+        if(result != LR_OK) {
+            return result;
+        }
     }
 
-    return NULL;
-}
+    sr->shards    = shards;
+    sr->shards_nr = shards_nr;
+    sr->owners_nr = owners_nr;
 
-struct lr_cell* lr_owner_allocate(struct linked_ring *lr) {
-    struct lr_cell *owner_cell;
-    struct lr_cell *needle;
-    struct lr_cell *head;
-    size_t owners_nr; 
+    return LR_OK;
+}
 
-    /* Calculate the number of owners in the linked ring buffer */
-    owners_nr = lr_owners_count(lr); 
+/**
+ * Add a new element to the shard of the owner. If the shard is full, it
+ * borrows free cells from the next shards.
+ *
+ * @param sr: pointer to the sharded linked ring
+ * @param data: the data to be added to the buffer
+ * @param owner: the owner of the new element
+ *
+ * @return LR_OK: if the element was successfully added
+ *         LR_ERROR_BUFFER_FULL: if no shard has free cells to lend
+ */
+lr_result_t lr_sharded_put(struct lr_sharded *sr, lr_data_t data,
+                           lr_owner_t owner)
+{
+    size_t home = lr_shard_nr(sr, owner);
+    struct linked_ring *shard = &sr->shards[home];
+    lr_result_t result;
+    size_t lent;
 
-    /* Allocate the owner cell at the appropriate position in the cells array */
-    owner_cell = &lr->cells[lr->size - owners_nr - 1];
+    result = lr_put(shard, data, owner);
+    while(result == LR_ERROR_BUFFER_FULL) {
+        lent = 0;
+        for(size_t idx = 1; idx < sr->shards_nr && lent == 0; idx++) {
+            lent = lr_lend(&sr->shards[(home + idx) & (sr->shards_nr - 1)],
+                           shard, LR_SHARD_LEND, sr->owners_nr);
+        }
 
-    /* If the owners array is not empty, check if the owner cell already exists */
-    if(lr->owners) {
-        /* Look up the owner cell starting from the next cell of the owners array */
-        needle = lr_cell_lookup(lr, lr->owners->next, owner_cell);
+        if(lent == 0) {
+            return LR_ERROR_BUFFER_FULL;
+        }
 
-        /* If the owner cell is found, return it */
-        if(needle)
-            return needle;
+        result = lr_put(shard, data, owner);
     }
-    
-    /* If the owner cell is the same as the write position, update the write position */
-    if(owner_cell == lr->write) {
-        lr->write = lr->write->next;
 
-        return owner_cell;
-    } 
+    return result;
+}
 
-    /* If the owner cell is not found in the linked ring buffer, lookup in the free pool */
-    head = lr->write;
-    needle = head;
-    while(needle->next != head && needle->next != owner_cell) {
-        needle = needle->next;
-    }
+/**
+ * Retrieve the next element of the owner from its shard.
+ *
+ * @param sr: pointer to the sharded linked ring
+ * @param data: pointer to the variable where the retrieved data will be stored
+ * @param owner: the owner of the retrieved element
+ *
+ * @return LR_OK: if the element was successfully retrieved
+ *         LR_ERROR_BUFFER_EMPTY: if the owner has no elements
+ */
+lr_result_t lr_sharded_get(struct lr_sharded *sr, lr_data_t *data,
+                           lr_owner_t owner)
+{
+    return lr_get(&sr->shards[lr_shard_nr(sr, owner)], data, owner);
+}
 
-    /* If the owner cell is found, update the next pointer to skip it */
-    if(needle->next == owner_cell) {
-        needle->next = needle->next->next;
+/* Number of elements in all shards */
+size_t lr_sharded_count(struct lr_sharded *sr)
+{
+    size_t count = 0;
 
-        return owner_cell;
+    for(size_t idx = 0; idx < sr->shards_nr; idx++) {
+        count += lr_count(&sr->shards[idx]);
     }
 
-    return NULL;
+    return count;
 }
 
-struct lr_cell* lr_owner_get(struct linked_ring *lr, lr_data_t owner) {
-    struct lr_cell *owner_cell = NULL;
-
-    /* Find the owner cell in the linked ring buffer */
-    owner_cell = lr_owner_find(lr, owner);
-    if(owner_cell)
-        return owner_cell;
-
-    /* If the write position is not empty, allocate a new owner cell */
-    if(!lr->write->next) 
-        return NULL;
+/* Number of free cells in all shards */
+size_t lr_sharded_available(struct lr_sharded *sr)
+{
+    size_t available = 0;
 
-    /* Allocate a new owner cell and update the owners array */
-    owner_cell = lr_owner_allocate(lr);
-    lr->owners = owner_cell;
-    owner_cell->data = owner;
-    owner_cell->next = NULL;
+    for(size_t idx = 0; idx < sr->shards_nr; idx++) {
+        available += lr_available(&sr->shards[idx]);
+    }
 
-    return owner_cell;
+    return available;
 }
 
-
+#if defined(LR_EVENTFD)
 /**
- * Count the number of elements owned by the specified owner in the linked ring buffer.
- * If limit is specified, it will stop counting after reaching the limit.
- * 
+ * Set the table of eventfds of owners, bindings are cleared. It should be
+ * called before the ring is shared between threads.
+ *
  * @param lr: pointer to the linked ring structure
- * @param limit: maximum number of elements to count (0 for no limit)
- * @param owner: the owner of the elements to count (0 for all owners)
- * 
- * @return the number of elements owned by the specified owner (up to the limit, if specified)
+ * @param events: caller supplied array of slots, NULL to disable eventfds of
+ *                owners
+ * @param events_nr: number of slots, power of two, not less than the number
+ *                   of bound owners
+ *
+ * @return LR_OK: if the table is set
+ *         LR_ERROR_NOMEMORY: if events_nr isn't a power of two
  */
-size_t lr_count_limited_owned(struct linked_ring *lr, size_t limit,
-                                lr_owner_t owner)
+lr_result_t lr_set_events(struct linked_ring *lr,
+                          struct lr_owner_event *events, size_t events_nr)
 {
-    size_t length;
-    struct lr_cell *head;
-    struct lr_cell *needle;
-    struct lr_cell *tail;
-    struct lr_cell *owner_cell;
-
-
-    lock(lr);
+    if(events != NULL) {
+        if(events_nr == 0 || (events_nr & (events_nr - 1)) != 0) {
+            return LR_ERROR_NOMEMORY;
+        }
 
-    length = 0;
-    owner_cell = lr_owner_find(lr, owner);
-    if(owner_cell == NULL) {
-        unlock_and_return(lr, length);
+        for(size_t idx = 0; idx < events_nr; idx++) {
+            events[idx].fd = -1;
+        }
+    } else {
+        events_nr = 0;
     }
 
-    head = lr_owner_head(lr, owner_cell); 
-    tail = lr_owner_tail(owner_cell);
-
-    needle = head;
-    length = 1;
-    while(needle != tail) {
-        needle = needle->next;
-        length += 1;
-    }
+    lr->events    = events;
+    lr->events_nr = events_nr;
 
-    unlock_and_return(lr, length);
+    return LR_OK;
 }
 
 /**
- * Count the number of elements in the linked ring buffer.
- * 
+ * Bind the eventfd to the owner. The eventfd is signalled when the owner
+ * without data gets an element, so the event loop should read the owner
+ * until LR_ERROR_BUFFER_EMPTY after the eventfd becomes readable.
+ *
  * @param lr: pointer to the linked ring structure
- * 
- * @return the number of elements in the buffer
+ * @param owner: the owner
+ * @param fd: the eventfd, -1 to unbind the owner
+ *
+ * @return LR_OK: if the eventfd is bound
+ *         LR_ERROR_NOMEMORY: if the table isn't set or it's full
  */
-size_t lr_count(struct linked_ring *lr) {
-    struct lr_cell *head;
-    struct lr_cell *needle;
-    size_t length;
+lr_result_t lr_bind_eventfd(struct linked_ring *lr, lr_owner_t owner, int fd)
+{
+    struct lr_owner_event *hole;
+    struct lr_owner_event *event;
+    size_t mask;
+    size_t home;
+    size_t hole_idx;
+    size_t idx;
+
+    if(lr->events == NULL) {
+        return LR_ERROR_NOMEMORY;
+    }
 
-    lock(lr);
+    lock(lr, owner);
 
-    length = 0;
-    if(lr->owners == NULL) {
-        unlock_and_return(lr, length);
+    hole = lr_event_find(lr, owner);
+    if(fd >= 0) {
+        if(hole == NULL) {
+            unlock_and_return(lr, owner, LR_ERROR_NOMEMORY);
+        }
+
+        hole->owner = owner;
+        hole->fd    = fd;
+
+        unlock_and_return(lr, owner, LR_OK);
     }
 
-    head = lr->owners->next;
-    length = 1;
-    needle = head;
-    while(needle->next != head) {
-        needle = needle->next;
-        length += 1;
+    if(hole == NULL || hole->fd < 0) {
+        unlock_and_return(lr, owner, LR_OK);
     }
 
-    unlock_and_return(lr, length);
-}
+    /* Following slots of the probe sequence are shifted back, so the table
+     * never keeps tombstones */
+    hole->fd = -1;
+    mask     = lr->events_nr - 1;
+    hole_idx = hole - lr->events;
+    idx      = hole_idx;
+    while(1) {
+        idx   = (idx + 1) & mask;
+        event = &lr->events[idx];
+        if(event->fd < 0) {
+            break;
+        }
+
+        /* Move the slot into the hole if its home isn't between hole and slot */
+        home = lr_event_hash(lr, event->owner);
+        if(((idx - home) & mask) >= ((idx - hole_idx) & mask)) {
+            lr->events[hole_idx] = *event;
+            event->fd            = -1;
+            hole_idx             = idx;
+        }
+    }
 
+    unlock_and_return(lr, owner, LR_OK);
+}
 
 /**
- * Set the mutex for a linked ring buffer.
- * 
- * @param lr: pointer to the linked ring structure to be initialized
- * @param attr: mutex attributes
+ * Set eventfds of the ring. The data eventfd is signalled when the empty ring
+ * gets an element, the space eventfd when cells are released in the full
+ * ring.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data_fd: eventfd of the non-empty ring, -1 to disable it
+ * @param space_fd: eventfd of the not full ring, -1 to disable it
+ *
+ * @return LR_OK
  */
-void lr_set_mutex(struct linked_ring *lr, struct lr_mutex_attr *attr)
+lr_result_t lr_set_eventfd(struct linked_ring *lr, int data_fd, int space_fd)
 {
-    lr->lock = attr->lock;
-    lr->unlock = attr->unlock;
-    lr->mutex_state = attr->state;
+    lr->data_fd  = data_fd;
+    lr->space_fd = space_fd;
+
+    return LR_OK;
 }
+#endif
 
+#if defined(LR_WAIT_FUTEX)
 /**
- * Add a new element to the linked ring buffer.
- * 
+ * Set futex words of owners for lr_get_wait() and lr_put_wait(). Owners are
+ * hashed into the words, owners with the same word wake each other up
+ * spuriously. It should be called before the ring is shared between threads.
+ *
  * @param lr: pointer to the linked ring structure
- * @param data: the data to be added to the buffer
- * @param owner: the owner of the new element
- * 
- * @return LR_OK: if the element was successfully added
- *         LR_ERROR_BUFFER_FULL: if the buffer is full and the element could not be added
+ * @param words: pointer to the array of wait words, NULL to disable waits
+ * @param words_nr: number of wait words, power of two
+ *
+ * @return LR_OK: if the wait words are set
+ *         LR_ERROR_NOMEMORY: if words_nr isn't a power of two
  */
-lr_result_t lr_put(struct linked_ring *lr, lr_data_t data, lr_data_t owner)
+lr_result_t lr_set_wait(struct linked_ring *lr, lr_lock_t *words,
+                        size_t words_nr)
 {
-    struct lr_cell *tail;
-    struct lr_cell *cell;
-    struct lr_cell *chain;
-    struct lr_cell *owner_cell;
-    struct lr_cell *prev_owner;
-    struct lr_cell *last_free;
-
-    lock(lr);
+    if(words != NULL) {
+        if(words_nr == 0 || (words_nr & (words_nr - 1)) != 0) {
+            return LR_ERROR_NOMEMORY;
+        }
 
-    if(lr->write == NULL) {
-        unlock_and_return(lr, LR_ERROR_BUFFER_FULL);
+        for(size_t idx = 0; idx < words_nr; idx++) {
+            words[idx] = 0;
+        }
+    } else {
+        words_nr = 0;
     }
 
-    owner_cell = lr_owner_get(lr, owner);
-    if(owner_cell == NULL) {
-        unlock_and_return(lr, LR_ERROR_BUFFER_FULL);
+    lr->wait_words    = words;
+    lr->wait_words_nr = words_nr;
+    lr->space_word    = 0;
+
+    return LR_OK;
+}
+
+/**
+ * Sleep on the wait word until it's changed from seq or the deadline passes.
+ *
+ * @param word: pointer to the wait word
+ * @param seq: value of the word before the operation was tried
+ * @param deadline: monotonic time to give up at, NULL to wait forever
+ *
+ * @return LR_OK: if the operation should be tried again
+ *         LR_ERROR_TIMEOUT: if the deadline has passed
+ */
+lr_result_t lr_wait_park(lr_lock_t *word, lr_lock_t seq,
+                         const struct timespec *deadline)
+{
+    struct timespec now;
+    struct timespec left;
+
+    /* Waiters are announced first, so the change made after it wakes them */
+    if((__atomic_fetch_or(word, LR_WAIT_PARKED, __ATOMIC_SEQ_CST) & ~LR_WAIT_PARKED) != seq) {
+        return LR_OK;
     }
-    tail = lr_owner_tail(owner_cell);
 
-    cell = lr->write;
-    lr->write = lr->write->next;
+    if(deadline == NULL) {
+        lr_futex_wait(word, seq | LR_WAIT_PARKED, NULL);
 
-    cell->data = data;
+        return LR_OK;
+    }
 
-    if(tail) {
-        /* If owner allready exists*/
-        cell->next = tail->next;
-        tail->next = cell;
-    } else {
-        /* If new owner */
-        if(owner_cell < lr_last_cell(lr)) {
-            /* If prev owner exists */
-            prev_owner = owner_cell + 1;        
-            chain = prev_owner->next->next;
-            cell->next = chain;
-            prev_owner->next->next = cell;
-        } else {
-            /* If first owner */
-            cell->next = cell;
-        }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left.tv_sec = deadline->tv_sec - now.tv_sec;
+    left.tv_nsec = deadline->tv_nsec - now.tv_nsec;
+    if(left.tv_nsec < 0) {
+        left.tv_sec -= 1;
+        left.tv_nsec += 1000000000L;
+    }
+    if(left.tv_sec < 0) {
+        return LR_ERROR_TIMEOUT;
     }
 
-    owner_cell->next = cell;
+    lr_futex_wait(word, seq | LR_WAIT_PARKED, &left);
 
-    unlock_and_return(lr, LR_OK);
+    return LR_OK;
 }
 
 /**
- * Add a new string element to the linked ring buffer.
- * 
- * @param lr: pointer to the linked ring structure
- * @param data: the string to be added to the buffer
- * @param owner: the owner of the new element
- * 
- * @return LR_OK: if the element was successfully added
- *         LR_ERROR_BUFFER_FULL: if the buffer is full and the element could not be added
+ * Convert the relative timeout to the monotonic deadline.
+ *
+ * @param deadline: pointer to the deadline to be set
+ * @param timeout: relative timeout
  */
-lr_result_t lr_put_string(struct linked_ring *lr, unsigned char *data,
-                           lr_owner_t owner)
+void lr_wait_deadline(struct timespec *deadline, const struct timespec *timeout)
 {
-    /* Loop through each character in the string */
-    while (*data) {
-        /* Add character to the buffer */
-        if (lr_put(lr, *(data++), owner) == LR_ERROR_BUFFER_FULL)
-            /* If the buffer is full, return an error */
-            return LR_ERROR_BUFFER_FULL;
-    };
-
-    /* If all characters were added successfully */
-    return LR_OK;
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += timeout->tv_sec;
+    deadline->tv_nsec += timeout->tv_nsec;
+    if(deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec += 1;
+        deadline->tv_nsec -= 1000000000L;
+    }
 }
 
 /**
- * Retrieve the next element from the linked ring buffer.
- * 
+ * Retrieve the element of the owner, blocking until the owner gets data.
+ *
  * @param lr: pointer to the linked ring structure
  * @param data: pointer to the variable where the retrieved data will be stored
  * @param owner: the owner of the retrieved element
- * 
- * @return LR_OK: if the element was successfully retrieved
- *         LR_ERROR_BUFFER_EMPTY: if the buffer is empty and no element could be retrieved
+ * @param timeout: relative timeout, NULL to wait forever
+ *
+ * @return LR_OK: if the element was retrieved
+ *         LR_ERROR_TIMEOUT: if the owner got no data before the timeout
+ *         LR_ERROR_NOMEMORY: if wait words aren't set with lr_set_wait()
+ *         LR_ERROR_LOCK, LR_ERROR_UNLOCK: if the mutex failed
  */
-lr_result_t lr_get(struct linked_ring *lr, lr_data_t *data, lr_owner_t owner)
+lr_result_t lr_get_wait(struct linked_ring *lr, lr_data_t *data,
+                        lr_owner_t owner, const struct timespec *timeout)
 {
-    struct lr_cell *head;
-    struct lr_cell *last_cell;
-    struct lr_cell *tail;
-    struct lr_cell *prev_owner;
-    struct lr_cell *owner_cell;
-
-    lock(lr);
+    struct timespec deadline;
+    lr_lock_t *word;
+    lr_lock_t seq;
+    lr_result_t result;
 
-    owner_cell = lr_owner_find(lr, owner);
-    if(owner_cell == NULL) {
-        return LR_ERROR_BUFFER_EMPTY;
+    if(lr->wait_words == NULL) {
+        return LR_ERROR_NOMEMORY;
     }
 
-    last_cell = lr_last_cell(lr);
-    if(owner_cell == last_cell) {
-        prev_owner = lr->owners;        
-    } else {
-        prev_owner = owner_cell + 1;        
+    if(timeout) {
+        lr_wait_deadline(&deadline, timeout);
     }
-    head = prev_owner->next->next;
-    prev_owner->next->next = head->next;
 
-    *data = head->data;
-    tail = lr_owner_tail(owner_cell);
-    if(head == tail) {
-        /* If last cell for owner */
-        /* delete and shorten the list, put a new link to lr->owners */
-        for(struct lr_cell *owner_swap = owner_cell; owner_swap > lr->owners; owner_swap--) {
-            struct lr_cell *next_owner = owner_swap - 1;
-            *owner_swap = *next_owner;
+    word = lr_wait_word(lr, owner);
+    do {
+        seq = __atomic_load_n(word, __ATOMIC_SEQ_CST) & ~LR_WAIT_PARKED;
+        result = lr_get(lr, data, owner);
+        if(result != LR_ERROR_BUFFER_EMPTY) {
+            return result;
         }
 
-        lr->owners->next = lr->write;
-        lr->write = lr->owners;
+        result = lr_wait_park(word, seq, timeout ? &deadline : NULL);
+    } while(result == LR_OK);
 
-        if(lr->owners == last_cell) {
-            lr->owners = NULL;
-        } else {
-            lr->owners += 1;
-        }
+    return result;
+}
+
+/**
+ * Add the element to the buffer, blocking until there is a free cell.
+ *
+ * @param lr: pointer to the linked ring structure
+ * @param data: the data to be added to the buffer
+ * @param owner: the owner of the new element
+ * @param timeout: relative timeout, NULL to wait forever
+ *
+ * @return LR_OK: if the element was added
+ *         LR_ERROR_TIMEOUT: if no cells were released before the timeout
+ *         LR_ERROR_NOMEMORY: if wait words aren't set with lr_set_wait()
+ *         LR_ERROR_LOCK, LR_ERROR_UNLOCK: if the mutex failed
+ */
+lr_result_t lr_put_wait(struct linked_ring *lr, lr_data_t data,
+                        lr_owner_t owner, const struct timespec *timeout)
+{
+    struct timespec deadline;
+    lr_lock_t seq;
+    lr_result_t result;
+
+    if(lr->wait_words == NULL) {
+        return LR_ERROR_NOMEMORY;
+    }
+
+    if(timeout) {
+        lr_wait_deadline(&deadline, timeout);
     }
 
-    head->next = lr->write;
-    lr->write = head;
+    do {
+        seq = __atomic_load_n(&lr->space_word, __ATOMIC_SEQ_CST) & ~LR_WAIT_PARKED;
+        result = lr_put(lr, data, owner);
+        if(result != LR_ERROR_BUFFER_FULL) {
+            return result;
+        }
+
+        result = lr_wait_park(&lr->space_word, seq, timeout ? &deadline : NULL);
+    } while(result == LR_OK);
 
-    unlock_and_return(lr, LR_OK);
+    return result;
 }
+#endif
 
 lr_result_t lr_print(struct linked_ring *lr) {
     struct lr_cell *head;
@@ -466,28 +4608,28 @@ lr_result_t lr_print(struct linked_ring *lr) {
     struct lr_cell *tail;
     struct lr_cell *owner_cell;
 
-    lock(lr);
+    lock(lr, 0);
 
     if(lr->owners == NULL) {
         printf("No owners found\n");
-        unlock_and_return(lr, LR_ERROR_BUFFER_EMPTY);
+        unlock_and_return(lr, 0, LR_ERROR_BUFFER_EMPTY);
     }
 
     for(owner_cell = lr_last_cell(lr); owner_cell >= lr->owners; owner_cell--) {
-        printf("Owner: %lu\n", owner_cell->data);
+        printf("Owner: %lu\n", (unsigned long) lr_cell_data(lr, owner_cell));
         head = lr_owner_head(lr, owner_cell); 
-        tail = lr_owner_tail(owner_cell);
+        tail = lr_owner_tail(lr, owner_cell);
 
         needle = head;
         printf("| ");
         while(needle != tail) {
-            printf("%lu | ", needle->data);
-            needle = needle->next;
+            printf("%lu | ", (unsigned long) lr_cell_data(lr, needle));
+            needle = lr_cell_next(lr, needle);
         }
-        printf("%lu | \n", needle->data);
+        printf("%lu | \n", (unsigned long) lr_cell_data(lr, needle));
     }
 
-    unlock_and_return(lr, LR_OK);
+    unlock_and_return(lr, 0, LR_OK);
 }
 
 
@@ -496,16 +4638,22 @@ lr_result_t lr_dump(struct linked_ring *lr)
     struct lr_cell *needle;
     struct lr_cell *head;
 
-    lock(lr);
+    /* Not thread-safe, lr_count() and lr_print() take the lock themselves */
     head = NULL;
     if(lr->owners) {
-        head = lr->owners->next->next;
+        head = lr_cell_next(lr, lr_owner_tail(lr, lr->owners));
     }
 
     printf("\nLinked ring buffer dump\n");
     printf("=======================\n");
     printf("head    : %p\n", head);
+#if defined(LR_POOL_LOCKFREE)
+    printf("write   : %p\n", (void *) lr_pool_cell(lr, lr->write));
+    printf("taken   : %u\n", lr->taken);
+#else
     printf("write   : %p\n", lr->write);
+#endif
+    printf("reserve : %u\n", lr->reserve);
     printf("cells   : %p\n", lr->cells);
     printf("capacity: %d\n", lr->size);
     printf("size    : %ld\n", lr_count(lr));
@@ -514,10 +4662,10 @@ lr_result_t lr_dump(struct linked_ring *lr)
     printf("\n");
 
    if (lr_count(lr) == 0) {
-        unlock_and_return(lr, LR_ERROR_BUFFER_EMPTY);
+        return LR_ERROR_BUFFER_EMPTY;
     }
 
     lr_print(lr);
 
-    unlock_and_return(lr, LR_OK);
+    return LR_OK;
 }
@@ -155,6 +155,12 @@ int main()
     test_assert(result == LR_OK,
                 "lr_put() should ok");
 
+    // Test lr_put_string(): String that doesn't fit leaves the buffer untouched
+    count  = lr_count(&buffer);
+    result = lr_put_string(&buffer, (unsigned char *) "ab", owner);
+    test_assert(result == LR_ERROR_BUFFER_FULL && lr_count(&buffer) == count,
+                "lr_put_string() should not add part of the string");
+
 
     lr_dump(&buffer);
     free(cells); // free memory for cells in the buffer
@@ -0,0 +1,173 @@
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 64
+#define OWNERS_NR   4
+#define SLOTS_NR    8
+#define LOCKS_NR    8
+#define ITEMS_NR    20000
+
+struct linked_ring buffer; // declare a buffer for the Linked Ring
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+struct lr_combine_slot slots[SLOTS_NR];
+struct lr_ticket_lock  ticket;
+lr_lock_t              locks[LOCKS_NR];
+
+lr_owner_t owners[OWNERS_NR];
+
+/* Producer of the owner puts the sequence of numbers */
+void *produce(void *state)
+{
+    lr_owner_t owner = *(lr_owner_t *) state;
+
+    for (lr_data_t data = 0; data < ITEMS_NR; data++) {
+        while (lr_put(&buffer, data, owner) != LR_OK) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Consumer of the owner checks that the sequence is in order */
+void *consume(void *state)
+{
+    lr_owner_t  owner = *(lr_owner_t *) state;
+    lr_data_t   data;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t expected = 0; expected < ITEMS_NR; expected++) {
+        while (lr_get(&buffer, &data, owner) != LR_OK) {
+            sched_yield();
+        }
+
+        if (data != expected) {
+            log_error("Owner %lu got %lu instead of %lu",
+                      (unsigned long) owner, (unsigned long) data,
+                      (unsigned long) expected);
+            result = LR_ERROR_UNKNOWN;
+            break;
+        }
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+lr_result_t run_producers_and_consumers()
+{
+    pthread_t   producers[OWNERS_NR];
+    pthread_t   consumers[OWNERS_NR];
+    lr_result_t result = LR_OK;
+    void       *ret;
+
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        owners[idx] = idx + 1;
+        pthread_create(&consumers[idx], NULL, consume, &owners[idx]);
+        pthread_create(&producers[idx], NULL, produce, &owners[idx]);
+    }
+
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        pthread_join(producers[idx], NULL);
+        pthread_join(consumers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = (lr_result_t) (uintptr_t) ret;
+        }
+    }
+
+    return result;
+}
+
+int main()
+{
+    lr_result_t result;
+    lr_data_t   data;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    // Test lr_set_combining(): Slots
+    result = lr_set_combining(&buffer, slots, SLOTS_NR - 1);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of combining slots should be power of two");
+
+    result = lr_set_combining(&buffer, slots, SLOTS_NR);
+    test_assert(result == LR_OK, "Combining slots should be set");
+
+    // Test lr_put(), lr_get(): Single thread is its own combiner
+    result = lr_put(&buffer, 42, 1);
+    test_assert(result == LR_OK, "Element should be put through the slot");
+
+    result = lr_get(&buffer, &data, 1);
+    test_assert(result == LR_OK && data == 42,
+                "Element should be retrieved through the slot");
+
+    result = lr_get(&buffer, &data, 1);
+    test_assert(result == LR_ERROR_BUFFER_EMPTY,
+                "Result of the combined request should be returned");
+
+    // Test lr_put(), lr_get(): Combined producers and consumers
+    lr_set_mutex(&buffer, &LR_MUTEX_TICKET(&ticket));
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Combined owners should get their elements in order");
+    test_assert(lr_count(&buffer) == 0 && lr_available(&buffer) == BUFFER_SIZE,
+                "All elements should be read and cells released");
+
+    // Test lr_put(), lr_get(): Requests are applied directly if slots are busy
+    lr_set_combining(&buffer, slots, 2);
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Owners should get their elements in order with busy slots");
+    test_assert(lr_count(&buffer) == 0 && lr_available(&buffer) == BUFFER_SIZE,
+                "All elements should be read and cells released");
+
+    // Test lr_put(), lr_get(): Combining with owner locks
+    lr_set_combining(&buffer, slots, SLOTS_NR);
+    lr_set_owner_locks(&buffer, locks, LOCKS_NR);
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Combined owners should get their elements with owner locks");
+    test_assert(lr_count(&buffer) == 0 && lr_available(&buffer) == BUFFER_SIZE,
+                "All elements should be read and cells released");
+
+    // Test lr_set_combining(): Disabled combining
+    lr_set_combining(&buffer, NULL, 0);
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Owners should get their elements without combining");
+
+    return LR_OK;
+}
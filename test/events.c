@@ -0,0 +1,175 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 16
+#define EVENTS_NR   8
+
+struct linked_ring buffer; // declare a buffer for the Linked Ring
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+struct lr_owner_event events[EVENTS_NR];
+
+/* Read the counter of the eventfd, 0 if it isn't signalled */
+uint64_t signalled(int fd)
+{
+    uint64_t counter;
+
+    if (read(fd, &counter, sizeof(counter)) != sizeof(counter)) {
+        return 0;
+    }
+
+    return counter;
+}
+
+int main()
+{
+    lr_result_t result;
+    lr_data_t   data;
+    lr_data_t   many[4] = {1, 2, 3, 4};
+    int         uart, spi, i2c, data_fd, space_fd;
+
+    uart     = eventfd(0, EFD_NONBLOCK);
+    spi      = eventfd(0, EFD_NONBLOCK);
+    i2c      = eventfd(0, EFD_NONBLOCK);
+    data_fd  = eventfd(0, EFD_NONBLOCK);
+    space_fd = eventfd(0, EFD_NONBLOCK);
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    // Test lr_set_events(), lr_bind_eventfd(): Table of owner eventfds
+    result = lr_bind_eventfd(&buffer, 1, uart);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Eventfd shouldn't be bound without the table");
+
+    result = lr_set_events(&buffer, events, EVENTS_NR - 1);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of event slots should be power of two");
+
+    result = lr_set_events(&buffer, events, EVENTS_NR);
+    test_assert(result == LR_OK, "Event slots should be set");
+
+    result = lr_bind_eventfd(&buffer, 1, uart);
+    test_assert(result == LR_OK, "Eventfd should be bound to the owner 1");
+    result = lr_bind_eventfd(&buffer, 2, spi);
+    test_assert(result == LR_OK, "Eventfd should be bound to the owner 2");
+    result = lr_bind_eventfd(&buffer, 3, i2c);
+    test_assert(result == LR_OK, "Eventfd should be bound to the owner 3");
+    lr_set_eventfd(&buffer, data_fd, space_fd);
+
+    // Test lr_put(): Owner and ring eventfds on empty to non-empty
+    lr_put(&buffer, 10, 1);
+    test_assert(signalled(uart) == 1 && signalled(data_fd) == 1
+                    && signalled(spi) == 0,
+                "Eventfds of the owner and the ring should be signalled");
+
+    lr_put(&buffer, 11, 1);
+    test_assert(signalled(uart) == 0 && signalled(data_fd) == 0,
+                "Eventfds shouldn't be signalled if the owner has data");
+
+    lr_put_many(&buffer, many, 4, 2);
+    test_assert(signalled(spi) == 1 && signalled(data_fd) == 0,
+                "Eventfd of the owner should be signalled by lr_put_many()");
+
+    lr_write(&buffer, (unsigned char *) "AT", 2, 3);
+    test_assert(signalled(i2c) == 1,
+                "Eventfd of the owner should be signalled by lr_write()");
+
+    lr_get(&buffer, &data, 1);
+    lr_get(&buffer, &data, 1);
+    lr_put(&buffer, 12, 1);
+    test_assert(signalled(uart) == 1,
+                "Eventfd should be signalled again after the owner is read");
+
+    // Test lr_get(): Space eventfd on full to not full
+    while (lr_available(&buffer) > 0) {
+        lr_put(&buffer, 13, 1);
+    }
+    test_assert(signalled(space_fd) == 0,
+                "Space eventfd shouldn't be signalled while filling");
+
+    lr_get(&buffer, &data, 1);
+    test_assert(signalled(space_fd) == 1,
+                "Space eventfd should be signalled when the full ring is read");
+
+    lr_get(&buffer, &data, 1);
+    test_assert(signalled(space_fd) == 0,
+                "Space eventfd shouldn't be signalled if the ring isn't full");
+
+    lr_put(&buffer, 14, 1);
+    lr_put(&buffer, 15, 1);
+    lr_drain(&buffer, 2, NULL, NULL);
+    test_assert(signalled(space_fd) == 1,
+                "Space eventfd should be signalled by lr_drain()");
+
+    // Test lr_bind_eventfd(): Unbound owner isn't signalled
+    lr_clear_owner(&buffer, 1);
+    result = lr_bind_eventfd(&buffer, 1, -1);
+    test_assert(result == LR_OK, "Owner 1 should be unbound");
+
+    lr_put(&buffer, 16, 1);
+    test_assert(signalled(uart) == 0,
+                "Eventfd of the unbound owner shouldn't be signalled");
+
+    lr_put(&buffer, 17, 2);
+    test_assert(signalled(spi) == 1,
+                "Eventfd of the owner 2 should stay bound");
+
+    // Test lr_bind_eventfd(): Full table
+    for (lr_owner_t owner = 4; owner < 4 + EVENTS_NR - 2; owner++) {
+        result = lr_bind_eventfd(&buffer, owner, uart);
+        test_assert(result == LR_OK, "Eventfd should be bound to the owner %lu",
+                    (unsigned long) owner);
+    }
+
+    result = lr_bind_eventfd(&buffer, 100, uart);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Eventfd shouldn't be bound to the full table");
+
+    for (lr_owner_t owner = 4; owner < 4 + EVENTS_NR - 2; owner++) {
+        lr_bind_eventfd(&buffer, owner, -1);
+    }
+
+    lr_clear_owner(&buffer, 2);
+    lr_clear_owner(&buffer, 3);
+    lr_put(&buffer, 18, 2);
+    lr_put(&buffer, 19, 3);
+    test_assert(signalled(spi) == 1 && signalled(i2c) == 1,
+                "Eventfds of owners should be found after unbinding others");
+
+    close(uart);
+    close(spi);
+    close(i2c);
+    close(data_fd);
+    close(space_fd);
+
+    return LR_OK;
+}
@@ -0,0 +1,161 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 16
+#define QUOTAS_NR   4
+
+struct linked_ring    buffer;
+struct lr_cell        cells[BUFFER_SIZE];
+struct lr_owner_quota quotas[QUOTAS_NR];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+/* Clock of the test, which is moved by hand */
+lr_time_t test_clock(void *state)
+{
+    return *(lr_time_t *) state;
+}
+
+lr_result_t test_expire()
+{
+    lr_result_t result;
+    lr_time_t   now = 100;
+    size_t      expired;
+    size_t      calls;
+
+#if defined(LR_CELL_INDEX_BITS) && LR_CELL_INDEX_BITS == 32 && !defined(LR_CELL_SOA)
+    // Stamp doesn't pad the data and the link
+    test_assert(sizeof(struct lr_cell)
+                    == sizeof(lr_time_t) + sizeof(lr_data_t) + sizeof(lr_index_t),
+                "Cell with the stamp takes %lu bytes", sizeof(struct lr_cell));
+#endif
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be initialized");
+    lr_set_clock(&buffer, test_clock, &now);
+
+    // Test lr_expire(): Elements don't expire without TTL
+    for (lr_data_t data = 0; data < 3; data++) {
+        lr_put(&buffer, data, 1);
+    }
+    now = 150;
+    lr_put(&buffer, 3, 2);
+    lr_put(&buffer, 4, 2);
+    expired = lr_expire(&buffer, 1000, BUFFER_SIZE);
+    test_assert(expired == 0 && lr_count(&buffer) == 5,
+                "Elements shouldn't expire without TTL");
+
+    // Test lr_expire(): Elements expire after TTL of the ring
+    lr_set_ttl(&buffer, 100);
+    expired = lr_expire(&buffer, 199, BUFFER_SIZE);
+    test_assert(expired == 0, "Elements shouldn't expire before TTL");
+    expired = lr_expire(&buffer, 200, BUFFER_SIZE);
+    test_assert(expired == 3 && lr_count_owned(&buffer, 1) == 0
+                    && lr_count_owned(&buffer, 2) == 2
+                    && buffer.expired == 3,
+                "Elements of the owner should expire, %lu expired",
+                (unsigned long) expired);
+
+    // Test lr_expire(): Work is bounded by the budget
+    now = 300;
+    for (lr_data_t data = 0; data < 4; data++) {
+        lr_put(&buffer, data, 1);
+    }
+    calls = 0;
+    do {
+        expired = lr_expire(&buffer, 1000, 2);
+        calls++;
+    } while (expired && expired <= 2);
+    test_assert(expired == 0 && calls > 3 && lr_count(&buffer) == 0
+                    && lr_available(&buffer) == BUFFER_SIZE,
+                "Elements should expire in %lu calls",
+                (unsigned long) calls);
+
+    // Test lr_set_owner_ttl(): Owner overrides TTL of the ring
+    result = lr_set_owner_ttl(&buffer, 3, 10);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Owner TTL should fail without the table");
+    lr_set_quotas(&buffer, quotas, QUOTAS_NR);
+    result = lr_set_owner_ttl(&buffer, 3, 10);
+    test_assert(result == LR_OK, "Owner TTL should be set");
+    now = 2000;
+    lr_put(&buffer, 0, 3);
+    lr_put(&buffer, 1, 3);
+    lr_put(&buffer, 0, 4);
+    lr_put(&buffer, 1, 4);
+    expired = lr_expire(&buffer, 2010, BUFFER_SIZE);
+    test_assert(expired == 2 && lr_count_owned(&buffer, 4) == 2,
+                "Only elements of the owner should expire");
+    lr_set_owner_ttl(&buffer, 3, 0);
+    test_assert(buffer.ttls == 0, "Owner TTL should be cleared");
+    lr_clear_owner(&buffer, 4);
+
+    // Test lr_set_owner_ttl(): Colliding owners clear their TTLs
+    lr_set_owner_ttl(&buffer, 1, 10);
+    lr_set_owner_ttl(&buffer, 4, 10);
+    lr_set_owner_ttl(&buffer, 1, 0);
+    lr_set_owner_ttl(&buffer, 4, 0);
+    for (size_t idx = 0; idx < QUOTAS_NR; idx++) {
+        test_assert(quotas[idx].ttl == 0, "Slot %lu shouldn't keep TTL",
+                    (unsigned long) idx);
+    }
+    now = 2500;
+    lr_put(&buffer, 0, 4);
+    expired = lr_expire(&buffer, 2550, BUFFER_SIZE);
+    test_assert(expired == 0 && buffer.ttls == 0,
+                "Owner should use TTL of the ring");
+    lr_clear_owner(&buffer, 4);
+
+    // Test lr_put(): Expired elements are reclaimed on the full ring
+    now = 3000;
+    for (lr_data_t data = 0; lr_put(&buffer, data, 5) == LR_OK; data++) {
+    }
+    now = 3050;
+    result = lr_put(&buffer, 0, 6);
+    test_assert(result == LR_ERROR_BUFFER_FULL,
+                "Element shouldn't be added before elements expire");
+    now    = 3100;
+    result = lr_put(&buffer, 0, 6);
+    test_assert(result == LR_OK && lr_count_owned(&buffer, 6) == 1
+                    && buffer.dropped == 0,
+                "Element should take the cell of expired one");
+    test_assert(lr_count_owned(&buffer, 5) + LR_EXPIRE_BUDGET
+                    >= BUFFER_SIZE - 1,
+                "Reclamation should be bounded by the budget");
+
+    return LR_OK;
+}
+
+int main()
+{
+    if (test_expire() != LR_OK) {
+        log_error("Elements should expire after TTL");
+        return 1;
+    }
+
+    return 0;
+}
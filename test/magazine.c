@@ -0,0 +1,198 @@
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 64
+#define THREADS_NR  4
+#define ITEMS_NR    20000
+
+struct linked_ring    buffer;
+struct lr_cell        cells[BUFFER_SIZE];
+struct lr_ticket_lock ticket;
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+lr_owner_t owners[THREADS_NR];
+
+/* Producer of the owner puts the sequence of numbers */
+void *produce(void *state)
+{
+    lr_owner_t owner = *(lr_owner_t *) state;
+
+    for (lr_data_t data = 0; data < ITEMS_NR; data++) {
+        while (lr_put(&buffer, data, owner) != LR_OK) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Consumer of the owner checks that the sequence is in order */
+void *consume(void *state)
+{
+    lr_owner_t  owner = *(lr_owner_t *) state;
+    lr_data_t   data;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t expected = 0; expected < ITEMS_NR; expected++) {
+        while (lr_get(&buffer, &data, owner) != LR_OK) {
+            sched_yield();
+        }
+
+        if (data != expected) {
+            log_error("Owner %lu got %lu instead of %lu",
+                      (unsigned long) owner, (unsigned long) data,
+                      (unsigned long) expected);
+            result = LR_ERROR_UNKNOWN;
+            break;
+        }
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+/* Put elements of the owner until the ring is full */
+size_t fill(lr_owner_t owner)
+{
+    size_t filled;
+
+    for (filled = 0; lr_put(&buffer, filled, owner) == LR_OK; filled++) {
+    }
+
+    return filled;
+}
+
+/* Read elements of the owner back in order */
+lr_result_t read_back(lr_owner_t owner, size_t filled)
+{
+    lr_data_t data;
+
+    for (lr_data_t expected = 0; expected < filled; expected++) {
+        if (lr_get(&buffer, &data, owner) != LR_OK || data != expected) {
+            return LR_ERROR_UNKNOWN;
+        }
+    }
+
+    return LR_OK;
+}
+
+int main()
+{
+    pthread_t   producers[THREADS_NR];
+    pthread_t   consumers[THREADS_NR];
+    lr_result_t result;
+    size_t      filled;
+    void       *ret;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    // Test lr_get(): Released cells are cached, but stay available
+    filled = fill(1);
+    test_assert(filled == BUFFER_SIZE - 1,
+                "Owner should put %d elements, put %lu", BUFFER_SIZE - 1,
+                (unsigned long) filled);
+    test_assert(read_back(1, filled) == LR_OK,
+                "Elements should be read back in order");
+    test_assert(buffer.cached > 0 && buffer.cached * 2 <= BUFFER_SIZE,
+                "Magazine should hold less than half of free cells, holds %u",
+                buffer.cached);
+    test_assert(lr_available(&buffer) == BUFFER_SIZE,
+                "Cached cells should be available, %lu available",
+                (unsigned long) lr_available(&buffer));
+
+    // Test lr_put(): Cached cells are taken by the thread
+    filled = fill(1);
+    test_assert(filled == BUFFER_SIZE - 1 && buffer.cached == 0,
+                "Owner should put %d elements again, put %lu",
+                BUFFER_SIZE - 1, (unsigned long) filled);
+    test_assert(read_back(1, filled) == LR_OK,
+                "Elements should be read back in order again");
+
+    // Test lr_put(): Owners with cached cells
+    test_assert(buffer.cached > 0, "Magazine should hold cells");
+    for (unsigned int idx = 0; idx < THREADS_NR; idx++) {
+        owners[idx] = idx + 2;
+        result      = lr_put(&buffer, 0, owners[idx]);
+        if (result != LR_OK) {
+            break;
+        }
+    }
+    test_assert(result == LR_OK && lr_owners_count(&buffer) == THREADS_NR,
+                "Owners should be added while cells are cached");
+    for (unsigned int idx = 0; idx < THREADS_NR; idx++) {
+        lr_clear_owner(&buffer, owners[idx]);
+    }
+
+    // Test lr_magazine_flush(): Cached cells are returned to the pool
+    lr_magazine_flush(&buffer);
+    test_assert(buffer.cached == 0 && lr_available(&buffer) == BUFFER_SIZE,
+                "Magazine should be flushed");
+
+    // Test lr_put() and lr_get(): Threads with own magazines
+    lr_set_mutex(&buffer, &LR_MUTEX_TICKET(&ticket));
+    for (unsigned int idx = 0; idx < THREADS_NR; idx++) {
+        pthread_create(&producers[idx], NULL, produce, &owners[idx]);
+        pthread_create(&consumers[idx], NULL, consume, &owners[idx]);
+    }
+
+    result = LR_OK;
+    for (unsigned int idx = 0; idx < THREADS_NR; idx++) {
+        pthread_join(producers[idx], NULL);
+        pthread_join(consumers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = LR_ERROR_UNKNOWN;
+        }
+    }
+    test_assert(result == LR_OK, "%d consumers should get %d elements in order",
+                THREADS_NR, ITEMS_NR);
+    lr_magazine_flush(&buffer);
+    test_assert(lr_count(&buffer) == 0 && buffer.cached == 0
+                    && lr_available(&buffer)
+                           == BUFFER_SIZE - lr_owners_count(&buffer),
+                "Magazines of exited threads should be returned, %u cached",
+                buffer.cached);
+
+    // Test lr_init(): Cells cached before initialization are dropped
+    filled = fill(1);
+    read_back(1, filled);
+    test_assert(buffer.cached > 0, "Magazine should hold cells");
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be initialized again");
+    filled = fill(1);
+    test_assert(filled == BUFFER_SIZE - 1 && buffer.cached == 0,
+                "Owner should put %d elements, put %lu", BUFFER_SIZE - 1,
+                (unsigned long) filled);
+    test_assert(read_back(1, filled) == LR_OK,
+                "Elements should be read back in order");
+
+    return 0;
+}
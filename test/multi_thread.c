@@ -156,7 +156,7 @@ lr_result_t test_multiple_threads(unsigned int num_threads, void *(*func)(void*)
     pthread_mutexattr_init(&pthread_attr);
     pthread_mutexattr_settype(&pthread_attr, PTHREAD_MUTEX_ERRORCHECK);
     pthread_mutex_init(&pthread_mutex, &pthread_attr);
-    struct lr_mutex_attr attr;
+    struct lr_mutex_attr attr = {0};
     attr.lock = pthread_lock;
     attr.unlock = pthread_unlock;
     attr.state = (void *) &pthread_mutex;
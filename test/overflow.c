@@ -0,0 +1,205 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 8
+#define INDEX_SIZE  8
+
+struct linked_ring   buffer;
+struct lr_cell       cells[BUFFER_SIZE];
+struct lr_owner_slot slots[INDEX_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+/* Get elements of the owner and check that they are the sequence */
+lr_result_t read_sequence(lr_owner_t owner, lr_data_t first, size_t nr)
+{
+    lr_data_t data;
+
+    for (lr_data_t expected = first; expected < first + nr; expected++) {
+        if (lr_get(&buffer, &data, owner) != LR_OK || data != expected) {
+            return LR_ERROR_UNKNOWN;
+        }
+    }
+
+    return lr_get(&buffer, &data, owner) == LR_ERROR_BUFFER_EMPTY
+               ? LR_OK
+               : LR_ERROR_UNKNOWN;
+}
+
+/* Fill the ring with elements of owners in turn, until it's full */
+void fill(lr_owner_t owners_nr)
+{
+    enum lr_overflow policy = buffer.overflow;
+    lr_data_t        data   = 0;
+
+    lr_set_overflow(&buffer, LR_OVERFLOW_FAIL);
+    while (lr_put(&buffer, data / owners_nr, 1 + data % owners_nr) == LR_OK) {
+        data++;
+    }
+    lr_set_overflow(&buffer, policy);
+}
+
+lr_result_t test_overflow(bool indexed)
+{
+    lr_result_t result;
+    size_t      count_1, count_2, count_3;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be initialized");
+    if (indexed) {
+        lr_set_index(&buffer, slots, INDEX_SIZE);
+    }
+
+    // Test lr_put(): Full ring fails by default
+    for (lr_data_t data = 0; data < BUFFER_SIZE - 1; data++) {
+        lr_put(&buffer, data, 1);
+    }
+    result = lr_put(&buffer, BUFFER_SIZE, 1);
+    test_assert(result == LR_ERROR_BUFFER_FULL,
+                "Element shouldn't be added to the full ring");
+
+    // Test lr_set_overflow(): Policy should be known
+    result = lr_set_overflow(&buffer, LR_OVERFLOW_LONGEST + 1);
+    test_assert(result == LR_ERROR_UNKNOWN, "Unknown policy should fail");
+
+    // Test lr_put(): Owner drops its oldest elements
+    result = lr_set_overflow(&buffer, LR_OVERFLOW_OWNER);
+    test_assert(result == LR_OK, "Owner policy should be set");
+    for (lr_data_t data = BUFFER_SIZE - 1; data < 3 * BUFFER_SIZE; data++) {
+        result = lr_put(&buffer, data, 1);
+        if (result != LR_OK) {
+            break;
+        }
+    }
+    test_assert(result == LR_OK && buffer.dropped == 2 * BUFFER_SIZE + 1,
+                "Elements should be added to the full ring, %lu dropped",
+                (unsigned long) buffer.dropped);
+    result = read_sequence(1, 2 * BUFFER_SIZE + 1, BUFFER_SIZE - 1);
+    test_assert(result == LR_OK, "Newest elements of the owner should be kept");
+
+    // Test lr_put(): Other owners keep their elements
+    fill(3);
+    count_2 = lr_count_owned(&buffer, 2);
+    count_3 = lr_count_owned(&buffer, 3);
+    for (lr_data_t data = 0; data < BUFFER_SIZE; data++) {
+        lr_put(&buffer, data, 1);
+    }
+    test_assert(lr_count_owned(&buffer, 2) == count_2
+                    && lr_count_owned(&buffer, 3) == count_3,
+                "Elements of other owners should be kept");
+    count_1 = lr_count_owned(&buffer, 1);
+    result  = read_sequence(1, BUFFER_SIZE - count_1, count_1);
+    test_assert(result == LR_OK, "Newest elements of the owner should be read");
+
+    // Test lr_put(): New owner drops elements of others
+    fill(3);
+    result = lr_put(&buffer, 42, 4);
+    test_assert(result == LR_OK && lr_count_owned(&buffer, 4) == 1,
+                "New owner should be added to the full ring");
+    test_assert(lr_available(&buffer) == 0
+                    && lr_count(&buffer) + lr_owners_count(&buffer)
+                           == BUFFER_SIZE,
+                "Ring should stay full");
+    for (lr_owner_t owner = 1; owner <= 4; owner++) {
+        lr_clear_owner(&buffer, owner);
+    }
+    test_assert(lr_count(&buffer) == 0 && lr_available(&buffer) == BUFFER_SIZE,
+                "All cells should be released");
+
+    // Test lr_put(): Owners drop their oldest elements in turn
+    lr_set_overflow(&buffer, LR_OVERFLOW_RING);
+    fill(2);
+    count_1 = lr_count_owned(&buffer, 1);
+    count_2 = lr_count_owned(&buffer, 2);
+    for (lr_data_t data = 0; data < 2; data++) {
+        result = lr_put(&buffer, 100 + data, 1);
+        if (result != LR_OK) {
+            break;
+        }
+    }
+    test_assert(result == LR_OK && lr_count_owned(&buffer, 1) == count_1 + 1
+                    && lr_count_owned(&buffer, 2) == count_2 - 1,
+                "Each owner should drop one element");
+    result = read_sequence(2, 1, count_2 - 1);
+    test_assert(result == LR_OK, "Oldest element of owner should be dropped");
+
+    // Test lr_set_overflow(): Owner with the most elements needs the index
+    result = lr_set_overflow(&buffer, LR_OVERFLOW_LONGEST);
+    if (!indexed) {
+        test_assert(result == LR_ERROR_NOMEMORY,
+                    "Longest policy should fail without the index");
+        return LR_OK;
+    }
+    test_assert(result == LR_OK, "Longest policy should be set");
+
+    // Test lr_put(): Owner with the most elements drops its oldest ones
+    lr_clear_owner(&buffer, 1);
+    lr_clear_owner(&buffer, 2);
+    for (lr_data_t data = 0; data < BUFFER_SIZE - 3; data++) {
+        lr_put(&buffer, data, 1);
+    }
+    lr_put(&buffer, 0, 2);
+    result = lr_put(&buffer, 1, 2);
+    test_assert(result == LR_OK && lr_count_owned(&buffer, 1) == BUFFER_SIZE - 4,
+                "Longest owner should drop the element");
+    result = lr_put(&buffer, 0, 3);
+    test_assert(result == LR_OK && lr_count_owned(&buffer, 1) == BUFFER_SIZE - 6
+                    && lr_count_owned(&buffer, 2) == 2,
+                "Longest owner should drop elements for the new owner");
+    result = read_sequence(1, 3, BUFFER_SIZE - 6);
+    test_assert(result == LR_OK, "Oldest elements of owner should be dropped");
+
+    // Test lr_put(): Owners with fewer elements keep them
+    lr_put(&buffer, 0, 1);
+    for (lr_data_t data = 0; data < 4 * BUFFER_SIZE; data++) {
+        lr_put(&buffer, data, 2);
+    }
+    count_1 = lr_count_owned(&buffer, 1);
+    count_3 = lr_count_owned(&buffer, 3);
+    test_assert(count_1 == 1 && count_3 == 1 && lr_available(&buffer) == 0,
+                "Owner should drop its own elements, %lu %lu kept",
+                (unsigned long) count_1, (unsigned long) count_3);
+    result = read_sequence(2, 4 * BUFFER_SIZE - 3, BUFFER_SIZE - 5);
+    test_assert(result == LR_OK, "Newest elements of the owner should be read");
+
+    return LR_OK;
+}
+
+int main()
+{
+    if (test_overflow(false) != LR_OK) {
+        log_error("Overflow without index should drop oldest elements");
+        return 1;
+    }
+
+    if (test_overflow(true) != LR_OK) {
+        log_error("Overflow with index should drop oldest elements");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,226 @@
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 64
+#define OWNERS_NR   8
+#define INDEX_SIZE  16
+#define LOCKS_NR    8
+#define ITEMS_NR    50000
+
+struct linked_ring   buffer; // declare a buffer for the Linked Ring
+struct lr_cell       cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+struct lr_owner_slot slots[INDEX_SIZE];
+lr_lock_t            locks[LOCKS_NR];
+
+lr_owner_t owners[OWNERS_NR];
+
+pthread_mutex_t mutex;
+pthread_mutex_t owner_mutexes[LOCKS_NR];
+
+enum lr_result mutex_lock(void *state, lr_owner_t owner)
+{
+    return pthread_mutex_lock((pthread_mutex_t *) state) == 0 ? LR_OK
+                                                              : LR_ERROR_LOCK;
+}
+
+enum lr_result mutex_unlock(void *state, lr_owner_t owner)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *) state) == 0
+               ? LR_OK
+               : LR_ERROR_UNLOCK;
+}
+
+enum lr_result owner_mutex_lock(void *state, size_t lock)
+{
+    return pthread_mutex_lock((pthread_mutex_t *) state + lock) == 0
+               ? LR_OK
+               : LR_ERROR_LOCK;
+}
+
+enum lr_result owner_mutex_unlock(void *state, size_t lock)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *) state + lock) == 0
+               ? LR_OK
+               : LR_ERROR_UNLOCK;
+}
+
+/* Producer of the owner puts the sequence of numbers */
+void *produce(void *state)
+{
+    lr_owner_t owner = *(lr_owner_t *) state;
+
+    for (lr_data_t data = 0; data < ITEMS_NR; data++) {
+        while (lr_put(&buffer, data, owner) != LR_OK) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Consumer of the owner checks that the sequence is in order */
+void *consume(void *state)
+{
+    lr_owner_t  owner = *(lr_owner_t *) state;
+    lr_data_t   data;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t expected = 0; expected < ITEMS_NR; expected++) {
+        while (lr_get(&buffer, &data, owner) != LR_OK) {
+            sched_yield();
+        }
+
+        if (data != expected) {
+            log_error("Owner %lu got %lu instead of %lu",
+                      (unsigned long) owner, (unsigned long) data,
+                      (unsigned long) expected);
+            result = LR_ERROR_UNKNOWN;
+            break;
+        }
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+lr_result_t run_producers_and_consumers()
+{
+    pthread_t   producers[OWNERS_NR];
+    pthread_t   consumers[OWNERS_NR];
+    lr_result_t result = LR_OK;
+    void       *ret;
+
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        owners[idx] = idx + 1;
+        pthread_create(&consumers[idx], NULL, consume, &owners[idx]);
+        pthread_create(&producers[idx], NULL, produce, &owners[idx]);
+    }
+
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        pthread_join(producers[idx], NULL);
+        pthread_join(consumers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = (lr_result_t) (uintptr_t) ret;
+        }
+    }
+
+    return result;
+}
+
+int main()
+{
+    lr_result_t result;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+#if defined(LR_CELL_UNALIGNED)
+    // Test lr_set_owner_locks(): Links of packed cells aren't atomic
+    result = lr_set_owner_locks(&buffer, locks, LOCKS_NR);
+    test_assert(result == LR_ERROR_LOCK,
+                "Owner locks should be refused for packed cells");
+
+    return 0;
+#endif
+
+    result = lr_set_owner_locks(&buffer, locks, LOCKS_NR - 1);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of owner locks should be power of two");
+
+    result = lr_set_owner_locks(&buffer, locks, LOCKS_NR);
+    test_assert(result == LR_OK, "Owner locks should be set");
+
+    // Test lr_put(), lr_get(): Producer and consumer of every owner
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Consumers should get data of their owners in order");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0,
+                "Buffer should be empty when all data is consumed");
+
+    // Test lr_put(), lr_get(): Owners are found with the index
+    result = lr_set_index(&buffer, slots, INDEX_SIZE);
+    test_assert(result == LR_OK, "Index should be attached to the buffer");
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Consumers should get data of their owners in order with "
+                "index");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0,
+                "Buffer should be empty when all data is consumed");
+
+    // Test lr_put(), lr_get(): Owner locks are mutexes of the caller
+    struct lr_mutex_attr owner_attr = {.state          = owner_mutexes,
+                                       .owner_locks_nr = LOCKS_NR - 1,
+                                       .owner_lock     = owner_mutex_lock,
+                                       .owner_unlock   = owner_mutex_unlock};
+
+    for (unsigned int idx = 0; idx < LOCKS_NR; idx++) {
+        pthread_mutex_init(&owner_mutexes[idx], NULL);
+    }
+
+    result = lr_set_mutex(&buffer, &owner_attr);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of owner mutexes should be power of two");
+
+    owner_attr.owner_locks_nr = LOCKS_NR;
+    result                    = lr_set_mutex(&buffer, &owner_attr);
+    test_assert(result == LR_OK, "Owner mutexes should be set");
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Consumers should get data of their owners in order with "
+                "owner mutexes");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0,
+                "Buffer should be empty when all data is consumed");
+
+    // Test lr_put(), lr_get(): The same with the ring-wide mutex
+    struct lr_mutex_attr attr = {
+        .state = &mutex, .lock = mutex_lock, .unlock = mutex_unlock};
+
+    pthread_mutex_init(&mutex, NULL);
+    result = lr_set_owner_locks(&buffer, NULL, 0);
+    test_assert(result == LR_OK, "Owner locks should be unset");
+    lr_set_mutex(&buffer, &attr);
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Consumers should get data of their owners in order with "
+                "mutex");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0
+                    && lr_available(&buffer) == BUFFER_SIZE,
+                "Buffer should be empty when all data is consumed");
+
+    return LR_OK;
+}
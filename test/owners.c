@@ -0,0 +1,417 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 256
+#define OWNERS_NR   64
+#define INDEX_SIZE  128
+#define STEPS       50000
+
+struct linked_ring   buffer; // declare a buffer for the Linked Ring
+struct lr_cell       cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+struct lr_owner_slot slots[INDEX_SIZE];
+
+/* Reference model: FIFO of every owner */
+lr_data_t    queue[OWNERS_NR][BUFFER_SIZE];
+unsigned int queue_head[OWNERS_NR];
+unsigned int queue_length[OWNERS_NR];
+unsigned int elements_nr;
+unsigned int owners_nr;
+
+/* Owners are spread over the whole range to exercise hashing */
+#define owner_id(idx) ((lr_owner_t) (idx) * 2654435761U + 7)
+
+lr_result_t model_put(unsigned int idx, lr_data_t data)
+{
+    unsigned int free = BUFFER_SIZE - elements_nr - owners_nr;
+    bool         new_owner = queue_length[idx] == 0;
+
+    if (free == 0 || (new_owner && free < 2)) {
+        return LR_ERROR_BUFFER_FULL;
+    }
+
+    queue[idx][(queue_head[idx] + queue_length[idx]) % BUFFER_SIZE] = data;
+    queue_length[idx]++;
+    elements_nr++;
+    owners_nr += new_owner;
+
+    return LR_OK;
+}
+
+lr_result_t model_get(unsigned int idx, lr_data_t *data)
+{
+    if (queue_length[idx] == 0) {
+        return LR_ERROR_BUFFER_EMPTY;
+    }
+
+    *data           = queue[idx][queue_head[idx]];
+    queue_head[idx] = (queue_head[idx] + 1) % BUFFER_SIZE;
+    queue_length[idx]--;
+    elements_nr--;
+    owners_nr -= queue_length[idx] == 0;
+
+    return LR_OK;
+}
+
+size_t model_put_many(unsigned int idx, const lr_data_t *src, size_t n)
+{
+    size_t put;
+
+    for (put = 0; put < n && model_put(idx, src[put]) == LR_OK; put++) {
+    }
+
+    return put;
+}
+
+lr_result_t model_put_bytes(unsigned int idx, const unsigned char *buf,
+                            size_t len)
+{
+    unsigned int free      = BUFFER_SIZE - elements_nr - owners_nr;
+    bool         new_owner = queue_length[idx] == 0;
+
+    // All or nothing
+    if (len + new_owner > free) {
+        return LR_ERROR_BUFFER_FULL;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        model_put(idx, buf[i]);
+    }
+
+    return LR_OK;
+}
+
+size_t model_get_many(unsigned int idx, lr_data_t *dst, size_t max)
+{
+    size_t got;
+
+    for (got = 0; got < max && model_get(idx, &dst[got]) == LR_OK; got++) {
+    }
+
+    return got;
+}
+
+size_t model_drain(unsigned int idx, lr_data_t *dst)
+{
+    return model_get_many(idx, dst, queue_length[idx]);
+}
+
+/* Collect drained elements */
+lr_data_t drained[BUFFER_SIZE];
+size_t    drained_nr;
+
+void collect(void *state, lr_data_t data)
+{
+    ((lr_data_t *) state)[drained_nr++] = data;
+}
+
+/* Walk the ring of all elements */
+unsigned int ring_length()
+{
+    struct lr_cell *head;
+    struct lr_cell *needle;
+    unsigned int    length;
+
+    if (buffer.owners == NULL) {
+        return 0;
+    }
+
+    head   = lr_cell_next(&buffer, buffer.owners);
+    needle = head;
+    length = 1;
+    while (lr_cell_next(&buffer, needle) != head) {
+        needle = lr_cell_next(&buffer, needle);
+        length++;
+    }
+
+    return length;
+}
+
+/* Run random operations and compare the buffer with the model */
+lr_result_t run_random_steps(unsigned int steps)
+{
+    lr_result_t   expected, result;
+    lr_data_t     expected_data, data;
+    lr_data_t     expected_run[BUFFER_SIZE], run[8];
+    unsigned char bytes[8];
+    size_t        expected_nr, nr, run_nr;
+    unsigned int  idx, operation;
+
+    for (unsigned int step = 0; step < steps; step++) {
+        idx       = rand() % OWNERS_NR;
+        operation = rand() % 100;
+        run_nr    = 1 + rand() % 8;
+        if (operation >= 45 && operation < 48) {
+            for (size_t i = 0; i < run_nr; i++) {
+                run[i] = step + i;
+            }
+            expected_nr = model_put_many(idx, run, run_nr);
+            nr          = lr_put_many(&buffer, run, run_nr, owner_id(idx));
+            if (nr != expected_nr) {
+                log_error("Step %u: put %lu of %lu for owner %u instead of %lu",
+                          step, nr, run_nr, idx, expected_nr);
+                return LR_ERROR_UNKNOWN;
+            }
+        } else if (operation >= 48 && operation < 50) {
+            for (size_t i = 0; i < run_nr; i++) {
+                bytes[i] = step + i;
+            }
+            expected = model_put_bytes(idx, bytes, run_nr);
+            result   = lr_put_bytes(&buffer, bytes, run_nr, owner_id(idx));
+            if (result != expected) {
+                log_error("Step %u: put %lu bytes for owner %u returns %d "
+                          "instead of %d",
+                          step, run_nr, idx, result, expected);
+                return LR_ERROR_UNKNOWN;
+            }
+        } else if (operation >= 90) {
+            expected_nr = model_get_many(idx, expected_run, run_nr);
+            nr          = lr_get_many(&buffer, run, run_nr, owner_id(idx));
+            if (nr != expected_nr) {
+                log_error("Step %u: got %lu of %lu for owner %u instead of %lu",
+                          step, nr, run_nr, idx, expected_nr);
+                return LR_ERROR_UNKNOWN;
+            }
+            for (size_t i = 0; i < nr; i++) {
+                if (run[i] != expected_run[i]) {
+                    log_error("Step %u: got %lu instead of %lu for owner %u",
+                              step, (unsigned long) run[i],
+                              (unsigned long) expected_run[i], idx);
+                    return LR_ERROR_UNKNOWN;
+                }
+            }
+        } else if (operation >= 88 && operation < 90) {
+            expected_nr = model_drain(idx, expected_run);
+            drained_nr  = 0;
+            if (operation == 88) {
+                nr = lr_drain(&buffer, owner_id(idx), collect, drained);
+            } else {
+                nr = lr_clear_owner(&buffer, owner_id(idx));
+            }
+            if (nr != expected_nr
+                || (operation == 88 && drained_nr != expected_nr)) {
+                log_error("Step %u: drained %lu (%lu visited) for owner %u "
+                          "instead of %lu",
+                          step, nr, drained_nr, idx, expected_nr);
+                return LR_ERROR_UNKNOWN;
+            }
+            for (size_t i = 0; i < drained_nr; i++) {
+                if (drained[i] != expected_run[i]) {
+                    log_error("Step %u: drained %lu instead of %lu for owner "
+                              "%u",
+                              step, (unsigned long) drained[i],
+                              (unsigned long) expected_run[i], idx);
+                    return LR_ERROR_UNKNOWN;
+                }
+            }
+        } else if (operation < 45) {
+            data     = step;
+            expected = model_put(idx, data);
+            result   = lr_put(&buffer, data, owner_id(idx));
+            if (result != expected) {
+                log_error("Step %u: put for owner %u returns %d instead of %d",
+                          step, idx, result, expected);
+                return LR_ERROR_UNKNOWN;
+            }
+        } else {
+            expected = model_get(idx, &expected_data);
+            result   = lr_get(&buffer, &data, owner_id(idx));
+            if (result != expected
+                || (result == LR_OK && data != expected_data)) {
+                log_error("Step %u: get for owner %u returns %d (%lu) instead "
+                          "of %d (%lu)",
+                          step, idx, result, (unsigned long) data, expected,
+                          (unsigned long) expected_data);
+                return LR_ERROR_UNKNOWN;
+            }
+        }
+
+        if (lr_owners_count(&buffer) != owners_nr) {
+            log_error("Step %u: %lu owners instead of %u", step,
+                      lr_owners_count(&buffer), owners_nr);
+            return LR_ERROR_UNKNOWN;
+        }
+
+        if (lr_count(&buffer) != elements_nr
+            || ring_length() != elements_nr) {
+            log_error("Step %u: %lu (%u) elements in the ring instead of %u",
+                      step, lr_count(&buffer), ring_length(), elements_nr);
+            return LR_ERROR_UNKNOWN;
+        }
+
+        if (lr_available(&buffer) != BUFFER_SIZE - elements_nr - owners_nr) {
+            log_error("Step %u: %lu cells available instead of %u", step,
+                      lr_available(&buffer),
+                      BUFFER_SIZE - elements_nr - owners_nr);
+            return LR_ERROR_UNKNOWN;
+        }
+    }
+
+    return LR_OK;
+}
+
+lr_result_t check_counts()
+{
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        if (lr_count_owned(&buffer, owner_id(idx)) != queue_length[idx]) {
+            log_error("Owner %u count %lu instead of %u", idx,
+                      lr_count_owned(&buffer, owner_id(idx)),
+                      queue_length[idx]);
+            return LR_ERROR_UNKNOWN;
+        }
+
+        if (lr_exists(&buffer, owner_id(idx)) != (queue_length[idx] > 0)) {
+            log_error("Owner %u should %sexist", idx,
+                      queue_length[idx] ? "" : "not ");
+            return LR_ERROR_UNKNOWN;
+        }
+    }
+
+    return LR_OK;
+}
+
+void reset_model()
+{
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        queue_head[idx]   = 0;
+        queue_length[idx] = 0;
+    }
+    elements_nr = 0;
+    owners_nr   = 0;
+}
+
+int main()
+{
+    lr_result_t result;
+
+    srand(1);
+
+#if defined(LR_CELL_INDEX_BITS) && !defined(LR_CELL_SOA) && !defined(LR_CELL_TIME)
+    // Compact cells don't have padding
+    test_assert(sizeof(struct lr_cell)
+                    == (LR_CELL_INDEX_BITS + LR_CELL_DATA_BITS) / 8,
+                "Cell with %d bits index and %d bits data takes %lu bytes",
+                LR_CELL_INDEX_BITS, LR_CELL_DATA_BITS, sizeof(struct lr_cell));
+#endif
+
+    reset_model();
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    result = run_random_steps(STEPS);
+    test_assert(result == LR_OK,
+                "Random operations without index should match the model");
+
+    result = check_counts();
+    test_assert(result == LR_OK, "Owners should count their elements");
+
+    // Test lr_set_index(): Index could be attached to the buffer in use
+    result = lr_set_index(&buffer, slots, INDEX_SIZE - 1);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Index size should be power of two");
+
+    result = lr_set_index(&buffer, slots, INDEX_SIZE);
+    test_assert(result == LR_OK, "Index should be attached to the buffer");
+
+    result = run_random_steps(STEPS);
+    test_assert(result == LR_OK,
+                "Random operations with index should match the model");
+
+    result = check_counts();
+    test_assert(result == LR_OK, "Owners should be found with the index");
+
+    // Test lr_set_index(): Index should be set on empty buffer as well
+    reset_model();
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be reinitialized");
+
+    result = lr_set_index(&buffer, slots, INDEX_SIZE);
+    test_assert(result == LR_OK, "Index should be attached to empty buffer");
+
+    result = run_random_steps(STEPS);
+    test_assert(result == LR_OK,
+                "Random operations with index from the start should match "
+                "the model");
+
+    result = check_counts();
+    test_assert(result == LR_OK, "Owners should count their elements");
+
+    // Test lr_put(): New owner is added, when the reserve is exhausted and
+    // the cell below the owners holds data, which isn't pinned
+    result = lr_init(&buffer, 16, cells);
+    test_assert(result == LR_OK, "Small buffer should be initialized");
+
+    for (lr_data_t data = 0; data < 15; data++) {
+        result = lr_put(&buffer, data, 1);
+        test_assert(result == LR_OK, "Element %lu should fill the buffer",
+                    (unsigned long) data);
+    }
+    for (lr_data_t expected_data = 0; expected_data < 8; expected_data++) {
+        lr_data_t data;
+
+        result = lr_get(&buffer, &data, 1);
+        test_assert(result == LR_OK && data == expected_data,
+                    "Element %lu should be read first",
+                    (unsigned long) expected_data);
+    }
+    test_assert(buffer.reserve == 0, "Reserve should be exhausted");
+
+    result = lr_put(&buffer, 100, 2);
+    test_assert(result == LR_OK, "Owner should move the pinned element");
+
+    test_assert(lr_available(&buffer) == 6,
+                "Buffer should have 6 free cells, not %lu",
+                (unsigned long) lr_available(&buffer));
+    result = lr_put(&buffer, 200, 3);
+    test_assert(result == LR_OK,
+                "Owner should move the element, which isn't pinned");
+
+    for (lr_data_t expected_data = 8; expected_data < 15; expected_data++) {
+        lr_data_t data;
+
+        result = lr_get(&buffer, &data, 1);
+        test_assert(result == LR_OK && data == expected_data,
+                    "Moved element %lu should be read in order",
+                    (unsigned long) expected_data);
+    }
+    test_assert(lr_owners_count(&buffer) == 2 && lr_count(&buffer) == 2,
+                "Elements of new owners should stay");
+
+#if defined(LR_POOL_LOCKFREE)
+    // Test lr_available(): Cells counted as taken before the pop could exceed
+    // free cells
+    buffer.taken += lr_available(&buffer) + 1;
+    test_assert(lr_available(&buffer) == 0,
+                "Free cells should saturate at 0, got %lu",
+                (unsigned long) lr_available(&buffer));
+    buffer.taken = 0;
+#endif
+
+    return LR_OK;
+}
@@ -0,0 +1,150 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 16
+#define INDEX_SIZE  8
+#define QUOTAS_NR   8
+
+struct linked_ring    buffer;
+struct lr_cell        cells[BUFFER_SIZE];
+struct lr_owner_slot  slots[INDEX_SIZE];
+struct lr_owner_quota quotas[QUOTAS_NR];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+/* Put elements of the owner until it fails */
+size_t fill(lr_owner_t owner)
+{
+    size_t filled;
+
+    for (filled = 0; lr_put(&buffer, filled, owner) == LR_OK; filled++) {
+    }
+
+    return filled;
+}
+
+lr_result_t test_quotas(bool indexed)
+{
+    lr_result_t   result;
+    lr_data_t     data;
+    lr_data_t     run[4] = {1, 2, 3, 4};
+    unsigned char bytes[4] = {1, 2, 3, 4};
+    unsigned char stream[2 * sizeof(lr_data_t)] = {0};
+    size_t        filled;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be initialized");
+    if (indexed) {
+        lr_set_index(&buffer, slots, INDEX_SIZE);
+    }
+
+    // Test lr_set_quotas(): Table of quotas
+    result = lr_set_quota(&buffer, 1, 0, 4);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Quota shouldn't be set without the table");
+    result = lr_set_quotas(&buffer, quotas, QUOTAS_NR - 1);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of slots should be power of two");
+    result = lr_set_quotas(&buffer, quotas, QUOTAS_NR);
+    test_assert(result == LR_OK, "Table of quotas should be set");
+    result = lr_set_quota(&buffer, 1, 5, 4);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Minimum shouldn't exceed the maximum");
+
+    // Test lr_put(): Owner doesn't exceed its maximum
+    result = lr_set_quota(&buffer, 1, 0, 4);
+    test_assert(result == LR_OK, "Maximum of the owner should be set");
+    filled = fill(1);
+    test_assert(filled == 4, "Owner should put 4 elements, put %lu",
+                (unsigned long) filled);
+    test_assert(lr_put_many(&buffer, run, 4, 1) == 0
+                    && lr_put_bytes(&buffer, bytes, 1, 1)
+                           == LR_ERROR_BUFFER_FULL,
+                "Elements above the maximum shouldn't be added");
+    lr_get(&buffer, &data, 1);
+    result = lr_put(&buffer, 4, 1);
+    test_assert(result == LR_OK, "Owner should put again below the maximum");
+
+    // Test lr_put(): Free cells are reserved for the owner
+    result = lr_set_quota(&buffer, 2, 4, 0);
+    test_assert(result == LR_OK && buffer.reserved == 5,
+                "Minimum should reserve cells with the owner cell, %lu",
+                (unsigned long) buffer.reserved);
+    filled = fill(3);
+    test_assert(filled == BUFFER_SIZE - 5 - 5 - 1,
+                "Other owner should leave reserved cells, put %lu",
+                (unsigned long) filled);
+    test_assert(lr_put_many(&buffer, run, 4, 2) == 4 && buffer.reserved == 0,
+                "Owner should put reserved elements");
+    test_assert(lr_put(&buffer, 5, 2) == LR_ERROR_BUFFER_FULL,
+                "Ring should be full");
+
+    // Test lr_get(): Cells are reserved again when elements are read
+    lr_get_many(&buffer, run, 2, 2);
+    test_assert(buffer.reserved == 2
+                    && lr_put(&buffer, 0, 3) == LR_ERROR_BUFFER_FULL
+                    && lr_put(&buffer, 0, 2) == LR_OK,
+                "Cells read from the owner should be reserved for it");
+
+    // Test lr_set_quota(): Existing elements are counted
+    result = lr_set_quota(&buffer, 3, 0, 2);
+    test_assert(result == LR_OK && lr_put(&buffer, 0, 3) == LR_ERROR_BUFFER_FULL,
+                "Owner above the new maximum shouldn't put");
+    while (lr_count_owned(&buffer, 3) > 1) {
+        lr_get(&buffer, &data, 3);
+    }
+    test_assert(lr_put(&buffer, 0, 3) == LR_OK,
+                "Owner should put below the new maximum");
+
+    // Test lr_set_quota(): Quotas are removed
+    lr_set_quota(&buffer, 2, 0, 0);
+    lr_set_quota(&buffer, 3, 0, 0);
+    test_assert(buffer.reserved == 0 && lr_put(&buffer, 0, 3) == LR_OK,
+                "Owner without quota should put");
+
+    // Test lr_write(): Stream doesn't exceed the maximum
+    lr_set_quota(&buffer, 4, 0, 1);
+    test_assert(lr_write(&buffer, stream, sizeof(stream), 4) == LR_CELL_BYTES,
+                "Stream should be written up to the maximum");
+
+    return LR_OK;
+}
+
+int main()
+{
+    if (test_quotas(false) != LR_OK) {
+        log_error("Quotas without index should be kept");
+        return 1;
+    }
+
+    if (test_quotas(true) != LR_OK) {
+        log_error("Quotas with index should be kept");
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 64
+#define SHARDS_NR   4
+#define OWNERS_NR   2
+#define THREADS_NR  4
+#define ITEMS_NR    20000
+
+struct lr_sharded  sharded;
+struct linked_ring shards[SHARDS_NR];
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_sharded_init(sr, shards, shards_nr, size, cells, owners_nr)     \
+        lr_sharded_init_soa(sr, shards, shards_nr, size, cells, payload,       \
+                            owners_nr)
+#endif
+struct lr_adaptive_lock locks[SHARDS_NR];
+
+lr_owner_t owners[THREADS_NR];
+
+/* Producer of the owner puts the sequence of numbers */
+void *produce(void *state)
+{
+    lr_owner_t owner = *(lr_owner_t *) state;
+
+    for (lr_data_t data = 0; data < ITEMS_NR; data++) {
+        while (lr_sharded_put(&sharded, data, owner) != LR_OK) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Consumer of the owner checks that the sequence is in order */
+void *consume(void *state)
+{
+    lr_owner_t  owner = *(lr_owner_t *) state;
+    lr_data_t   data;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t expected = 0; expected < ITEMS_NR; expected++) {
+        while (lr_sharded_get(&sharded, &data, owner) != LR_OK) {
+            sched_yield();
+        }
+
+        if (data != expected) {
+            log_error("Owner %lu got %lu instead of %lu",
+                      (unsigned long) owner, (unsigned long) data,
+                      (unsigned long) expected);
+            result = LR_ERROR_UNKNOWN;
+            break;
+        }
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+/* Put elements of the owner until the ring is full and read them back */
+lr_result_t fill_and_read(lr_owner_t owner, size_t *filled)
+{
+    lr_data_t data;
+
+    for (*filled = 0; lr_sharded_put(&sharded, *filled, owner) == LR_OK;
+         (*filled)++) {
+    }
+
+    for (lr_data_t expected = 0; expected < *filled; expected++) {
+        if (lr_sharded_get(&sharded, &data, owner) != LR_OK
+            || data != expected) {
+            return LR_ERROR_UNKNOWN;
+        }
+    }
+
+    return lr_sharded_get(&sharded, &data, owner) == LR_ERROR_BUFFER_EMPTY
+               ? LR_OK
+               : LR_ERROR_UNKNOWN;
+}
+
+int main()
+{
+    pthread_t   producers[THREADS_NR];
+    pthread_t   consumers[THREADS_NR];
+    lr_result_t result;
+    lr_owner_t  other;
+    size_t      filled;
+    size_t      expected;
+    void       *ret;
+
+    // Test lr_sharded_init(): Shards
+    result = lr_sharded_init(&sharded, shards, SHARDS_NR - 1, BUFFER_SIZE,
+                             cells, OWNERS_NR);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of shards should be power of two");
+
+    result = lr_sharded_init(&sharded, shards, SHARDS_NR, BUFFER_SIZE, cells,
+                             BUFFER_SIZE / SHARDS_NR);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Shards should have cells for more than owner cells");
+
+    result = lr_sharded_init(&sharded, shards, SHARDS_NR, BUFFER_SIZE, cells,
+                             OWNERS_NR);
+    test_assert(result == LR_OK, "Sharded buffer should be initialized");
+    test_assert(lr_sharded_available(&sharded) == BUFFER_SIZE,
+                "All %d cells should be available", BUFFER_SIZE);
+
+    // Test lr_sharded_put(): Full shard borrows cells of neighbours
+#if defined(LR_CELL_INDEX_BITS)
+    expected = BUFFER_SIZE / SHARDS_NR - 1;
+#else
+    expected = BUFFER_SIZE - 1 - (SHARDS_NR - 1) * OWNERS_NR;
+#endif
+    result = fill_and_read(1, &filled);
+    test_assert(result == LR_OK && filled == expected,
+                "Owner should put %lu elements and read them in order, put %lu",
+                (unsigned long) expected, (unsigned long) filled);
+    test_assert(lr_sharded_count(&sharded) == 0
+                    && lr_sharded_available(&sharded) == BUFFER_SIZE,
+                "Cells should be kept by shards after the owner is read");
+
+    // Test lr_sharded_put(): Cells are borrowed back by the lender
+    for (other = 2; lr_shard_nr(&sharded, other) == lr_shard_nr(&sharded, 1);
+         other++) {
+    }
+
+    result = fill_and_read(other, &filled);
+    test_assert(result == LR_OK && filled == expected,
+                "Owner of other shard should borrow cells back, put %lu",
+                (unsigned long) filled);
+
+    // Test lr_sharded_put(), lr_sharded_get(): Producers and consumers
+    for (unsigned int idx = 0; idx < SHARDS_NR; idx++) {
+        lr_set_mutex(&shards[idx], &LR_MUTEX_ADAPTIVE(&locks[idx]));
+    }
+
+    for (unsigned int idx = 0; idx < THREADS_NR; idx++) {
+        owners[idx] = idx + 1;
+        pthread_create(&consumers[idx], NULL, consume, &owners[idx]);
+        pthread_create(&producers[idx], NULL, produce, &owners[idx]);
+    }
+
+    result = LR_OK;
+    for (unsigned int idx = 0; idx < THREADS_NR; idx++) {
+        pthread_join(producers[idx], NULL);
+        pthread_join(consumers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = (lr_result_t) (uintptr_t) ret;
+        }
+    }
+    test_assert(result == LR_OK,
+                "Owners should get their elements in order from shards");
+    test_assert(lr_sharded_count(&sharded) == 0
+                    && lr_sharded_available(&sharded) == BUFFER_SIZE,
+                "All elements should be read and cells kept by shards");
+
+    return LR_OK;
+}
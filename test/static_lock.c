@@ -0,0 +1,155 @@
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 64
+#define OWNERS_NR   4
+#define LOCKS_NR    8
+#define SLOTS_NR    4
+#define ITEMS_NR    20000
+
+struct linked_ring buffer; // declare a buffer for the Linked Ring
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+lr_lock_t              locks[LOCKS_NR];
+struct lr_ticket_lock  ticket;
+struct lr_combine_slot slots[SLOTS_NR];
+struct lr_owner_quota  quotas[SLOTS_NR];
+
+lr_owner_t owners[OWNERS_NR];
+
+/* Producer of the owner puts the sequence of numbers */
+void *produce(void *state)
+{
+    lr_owner_t owner = *(lr_owner_t *) state;
+
+    for (lr_data_t data = 0; data < ITEMS_NR; data++) {
+        while (lr_put(&buffer, data, owner) != LR_OK) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+/* Consumer of the owner checks that the sequence is in order */
+void *consume(void *state)
+{
+    lr_owner_t  owner = *(lr_owner_t *) state;
+    lr_data_t   data;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t expected = 0; expected < ITEMS_NR; expected++) {
+        while (lr_get(&buffer, &data, owner) != LR_OK) {
+            sched_yield();
+        }
+
+        if (data != expected) {
+            log_error("Owner %lu got %lu instead of %lu",
+                      (unsigned long) owner, (unsigned long) data,
+                      (unsigned long) expected);
+            result = LR_ERROR_UNKNOWN;
+            break;
+        }
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+int main()
+{
+    pthread_t            producers[OWNERS_NR];
+    pthread_t            consumers[OWNERS_NR];
+    struct lr_mutex_attr attr = {0};
+    lr_result_t          result;
+    void                *ret;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    // Test lr_set_mutex(): Lock is fixed at build time
+    result = lr_set_mutex(&buffer, &LR_MUTEX_TICKET(&ticket));
+    test_assert(result == LR_ERROR_LOCK,
+                "Mutex shouldn't replace the lock fixed at build time");
+
+    result = lr_set_owner_locks(&buffer, locks, LOCKS_NR);
+    test_assert(result == LR_ERROR_LOCK,
+                "Owner locks shouldn't replace the lock fixed at build time");
+
+    result = lr_set_mutex(&buffer, &attr);
+    test_assert(result == LR_OK, "Empty mutex attributes should be accepted");
+
+    // Test lr_set_combining(), lr_set_quotas(), lr_set_overflow(): Checks of
+    // lr_put() and lr_get() are compiled out with the lock fixed at build time
+    result = lr_set_combining(&buffer, slots, SLOTS_NR);
+    test_assert(result == LR_ERROR_LOCK,
+                "Combining shouldn't be set with the lock fixed at build time");
+
+    result = lr_set_quotas(&buffer, quotas, SLOTS_NR);
+    test_assert(result == LR_ERROR_LOCK,
+                "Quotas shouldn't be set with the lock fixed at build time");
+
+    result = lr_set_overflow(&buffer, LR_OVERFLOW_RING);
+    test_assert(result == LR_ERROR_LOCK,
+                "Overflow shouldn't be set with the lock fixed at build time");
+
+    result = lr_set_overflow(&buffer, LR_OVERFLOW_FAIL);
+    test_assert(result == LR_OK, "Failing on the full ring should be set");
+
+#if LR_LOCK != LR_LOCK_NONE
+    // Test lr_put(), lr_get(): Producers and consumers of owners
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        owners[idx] = idx + 1;
+        pthread_create(&consumers[idx], NULL, consume, &owners[idx]);
+        pthread_create(&producers[idx], NULL, produce, &owners[idx]);
+    }
+
+    result = LR_OK;
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        pthread_join(producers[idx], NULL);
+        pthread_join(consumers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = (lr_result_t) (uintptr_t) ret;
+        }
+    }
+    test_assert(result == LR_OK,
+                "Owners should get their elements in order with %d threads",
+                OWNERS_NR * 2);
+#else
+    (void) producers;
+    (void) consumers;
+    (void) ret;
+#endif
+
+    test_assert(lr_count(&buffer) == 0 && lr_available(&buffer) == BUFFER_SIZE,
+                "All elements should be read and cells released");
+
+    return LR_OK;
+}
@@ -0,0 +1,238 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 128
+#define OWNERS_NR   16
+#define STEPS       20000
+#define CHUNK_SIZE  32
+
+struct linked_ring buffer; // declare a buffer for the Linked Ring
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+/* Reference model: bytes and cell fills of every stream */
+unsigned char stream[OWNERS_NR][BUFFER_SIZE * sizeof(lr_data_t)];
+unsigned int  stream_head[OWNERS_NR];
+unsigned int  stream_length[OWNERS_NR];
+unsigned int  fills[OWNERS_NR][BUFFER_SIZE];
+unsigned int  fills_head[OWNERS_NR];
+unsigned int  fills_length[OWNERS_NR];
+unsigned int  cells_nr;
+unsigned int  owners_nr;
+
+#define STREAM_SIZE (BUFFER_SIZE * sizeof(lr_data_t))
+
+/* Stream owners of UART, SPI and so on */
+#define owner_id(idx) ((lr_owner_t) (idx) + 1)
+
+#define fill_at(idx, nr) fills[idx][(fills_head[idx] + (nr)) % BUFFER_SIZE]
+
+size_t model_write(unsigned int idx, const unsigned char *buf, size_t len)
+{
+    unsigned int free;
+    size_t       written = 0;
+
+    if (fills_length[idx]) {
+        // Top up the last cell
+        unsigned int *fill = &fill_at(idx, fills_length[idx] - 1);
+        while (*fill < LR_CELL_BYTES && written < len) {
+            (*fill)++;
+            written++;
+        }
+    } else {
+        free = BUFFER_SIZE - cells_nr - owners_nr;
+        if (free < 2) {
+            return 0;
+        }
+        owners_nr++;
+    }
+
+    while (written < len && BUFFER_SIZE - cells_nr - owners_nr > 0) {
+        fill_at(idx, fills_length[idx]) = 0;
+        while (fill_at(idx, fills_length[idx]) < LR_CELL_BYTES
+               && written < len) {
+            fill_at(idx, fills_length[idx])++;
+            written++;
+        }
+        fills_length[idx]++;
+        cells_nr++;
+    }
+
+    for (size_t i = 0; i < written; i++) {
+        stream[idx][(stream_head[idx] + stream_length[idx]) % STREAM_SIZE] =
+            buf[i];
+        stream_length[idx]++;
+    }
+
+    return written;
+}
+
+size_t model_read(unsigned int idx, unsigned char *buf, size_t max)
+{
+    size_t got = 0;
+
+    while (got < max && fills_length[idx]) {
+        unsigned int *fill = &fill_at(idx, 0);
+        while (*fill && got < max) {
+            (*fill)--;
+            got++;
+        }
+        if (*fill == 0) {
+            fills_head[idx] = (fills_head[idx] + 1) % BUFFER_SIZE;
+            fills_length[idx]--;
+            cells_nr--;
+            owners_nr -= fills_length[idx] == 0;
+        }
+    }
+
+    for (size_t i = 0; i < got; i++) {
+        buf[i]           = stream[idx][stream_head[idx]];
+        stream_head[idx] = (stream_head[idx] + 1) % STREAM_SIZE;
+        stream_length[idx]--;
+    }
+
+    return got;
+}
+
+void reset_model()
+{
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        stream_head[idx]   = 0;
+        stream_length[idx] = 0;
+        fills_head[idx]    = 0;
+        fills_length[idx]  = 0;
+    }
+    cells_nr  = 0;
+    owners_nr = 0;
+}
+
+/* Run random writes and reads and compare the buffer with the model */
+lr_result_t run_random_steps(unsigned int steps)
+{
+    unsigned char expected_chunk[CHUNK_SIZE], chunk[CHUNK_SIZE];
+    size_t        expected_nr, nr, len;
+    unsigned int  idx;
+
+    for (unsigned int step = 0; step < steps; step++) {
+        idx = rand() % OWNERS_NR;
+        len = 1 + rand() % CHUNK_SIZE;
+        if (rand() % 2) {
+            for (size_t i = 0; i < len; i++) {
+                chunk[i] = rand();
+            }
+            expected_nr = model_write(idx, chunk, len);
+            nr          = lr_write(&buffer, chunk, len, owner_id(idx));
+            if (nr != expected_nr) {
+                log_error("Step %u: wrote %lu of %lu bytes for owner %u "
+                          "instead of %lu",
+                          step, nr, len, idx, expected_nr);
+                return LR_ERROR_UNKNOWN;
+            }
+        } else {
+            expected_nr = model_read(idx, expected_chunk, len);
+            nr          = lr_read(&buffer, chunk, len, owner_id(idx));
+            if (nr != expected_nr) {
+                log_error("Step %u: read %lu of %lu bytes for owner %u "
+                          "instead of %lu",
+                          step, nr, len, idx, expected_nr);
+                return LR_ERROR_UNKNOWN;
+            }
+            for (size_t i = 0; i < nr; i++) {
+                if (chunk[i] != expected_chunk[i]) {
+                    log_error("Step %u: byte %lu is %u instead of %u", step,
+                              i, chunk[i], expected_chunk[i]);
+                    return LR_ERROR_UNKNOWN;
+                }
+            }
+        }
+
+        if (lr_count(&buffer) != cells_nr
+            || lr_owners_count(&buffer) != owners_nr) {
+            log_error("Step %u: %lu cells of %lu owners instead of %u of %u",
+                      step, lr_count(&buffer), lr_owners_count(&buffer),
+                      cells_nr, owners_nr);
+            return LR_ERROR_UNKNOWN;
+        }
+    }
+
+    return LR_OK;
+}
+
+int main()
+{
+    lr_result_t   result;
+    unsigned char data[BUFFER_SIZE * sizeof(lr_data_t)];
+    size_t        nr;
+
+    srand(1);
+
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = i;
+    }
+
+    // Test lr_write(): Bytes are packed into cells
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    nr = lr_write(&buffer, data, sizeof(data), owner_id(0));
+    test_assert(nr == (BUFFER_SIZE - 1) * LR_CELL_BYTES,
+                "Buffer should hold %lu bytes of the stream, but %lu written",
+                (BUFFER_SIZE - 1) * LR_CELL_BYTES, nr);
+
+    nr = lr_write(&buffer, data, 1, owner_id(0));
+    test_assert(nr == 0, "lr_write() should not write to the full buffer");
+
+    // Test lr_read(): Bytes are read in the written order
+    nr = lr_read(&buffer, data + 1, 1, owner_id(0));
+    test_assert(nr == 1 && data[1] == 0,
+                "First byte should be read from the stream");
+
+    nr = lr_read(&buffer, data, sizeof(data), owner_id(0));
+    test_assert(nr == (BUFFER_SIZE - 1) * LR_CELL_BYTES - 1,
+                "Rest of the stream should be read, but %lu bytes read", nr);
+
+    size_t mismatch = 0;
+    while (mismatch < nr && data[mismatch] == (unsigned char) (mismatch + 1)) {
+        mismatch++;
+    }
+    test_assert(mismatch == nr, "Bytes should be read in the written order");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0,
+                "Buffer should be empty after the stream is read");
+
+    // Test lr_write(), lr_read(): Streams of many owners
+    reset_model();
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be reinitialized");
+
+    result = run_random_steps(STEPS);
+    test_assert(result == LR_OK, "Random streams should match the model");
+
+    return LR_OK;
+}
@@ -0,0 +1,239 @@
+#include <lr.h> // include header for Linked Ring library
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 16
+#define OWNERS_NR   4
+#define WORDS_NR    4
+#define LOCKS_NR    4
+#define ITEMS_NR    20000
+
+struct linked_ring buffer; // declare a buffer for the Linked Ring
+struct lr_cell     cells[BUFFER_SIZE];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+lr_lock_t words[WORDS_NR];
+lr_lock_t locks[LOCKS_NR];
+
+lr_owner_t owners[OWNERS_NR];
+
+pthread_mutex_t mutex;
+
+enum lr_result mutex_lock(void *state, lr_owner_t owner)
+{
+    return pthread_mutex_lock((pthread_mutex_t *) state) == 0 ? LR_OK
+                                                              : LR_ERROR_LOCK;
+}
+
+enum lr_result mutex_unlock(void *state, lr_owner_t owner)
+{
+    return pthread_mutex_unlock((pthread_mutex_t *) state) == 0
+               ? LR_OK
+               : LR_ERROR_UNLOCK;
+}
+
+/* Producer of the owner blocks while the buffer is full */
+void *produce(void *state)
+{
+    lr_owner_t  owner  = *(lr_owner_t *) state;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t data = 0; data < ITEMS_NR && result == LR_OK; data++) {
+        result = lr_put_wait(&buffer, data, owner, NULL);
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+/* Consumer of the owner blocks until the owner gets data */
+void *consume(void *state)
+{
+    lr_owner_t  owner = *(lr_owner_t *) state;
+    lr_data_t   data;
+    lr_result_t result = LR_OK;
+
+    for (lr_data_t expected = 0; expected < ITEMS_NR; expected++) {
+        result = lr_get_wait(&buffer, &data, owner, NULL);
+        if (result != LR_OK) {
+            break;
+        }
+
+        if (data != expected) {
+            log_error("Owner %lu got %lu instead of %lu",
+                      (unsigned long) owner, (unsigned long) data,
+                      (unsigned long) expected);
+            result = LR_ERROR_UNKNOWN;
+            break;
+        }
+    }
+
+    return (void *) (uintptr_t) result;
+}
+
+lr_result_t run_producers_and_consumers()
+{
+    pthread_t   producers[OWNERS_NR];
+    pthread_t   consumers[OWNERS_NR];
+    lr_result_t result = LR_OK;
+    void       *ret;
+
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        owners[idx] = idx + 1;
+        pthread_create(&consumers[idx], NULL, consume, &owners[idx]);
+        pthread_create(&producers[idx], NULL, produce, &owners[idx]);
+    }
+
+    for (unsigned int idx = 0; idx < OWNERS_NR; idx++) {
+        pthread_join(producers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = (lr_result_t) (uintptr_t) ret;
+        }
+        pthread_join(consumers[idx], &ret);
+        if ((lr_result_t) (uintptr_t) ret != LR_OK) {
+            result = (lr_result_t) (uintptr_t) ret;
+        }
+    }
+
+    return result;
+}
+
+/* Milliseconds elapsed since start */
+long elapsed_ms(struct timespec *start)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - start->tv_sec) * 1000
+           + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+int main()
+{
+    lr_result_t     result;
+    lr_data_t       data;
+    struct timespec start;
+    struct timespec timeout = {.tv_sec = 0, .tv_nsec = 20000000};
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer with size %d should be initialized",
+                BUFFER_SIZE);
+
+    // Test lr_set_wait(): Wait words are required
+    result = lr_get_wait(&buffer, &data, 1, &timeout);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "lr_get_wait() should fail without wait words");
+
+    result = lr_set_wait(&buffer, words, WORDS_NR - 1);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Number of wait words should be power of two");
+
+    result = lr_set_wait(&buffer, words, WORDS_NR);
+    test_assert(result == LR_OK, "Wait words should be set");
+
+    // Test lr_get_wait(): Timeout of the empty owner
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    result = lr_get_wait(&buffer, &data, 1, &timeout);
+    test_assert(result == LR_ERROR_TIMEOUT && elapsed_ms(&start) >= 19,
+                "lr_get_wait() should time out after %ld ms",
+                elapsed_ms(&start));
+
+    // Test lr_put_wait(): Timeout of the full buffer
+    for (lr_data_t idx = 0; idx < BUFFER_SIZE - 1; idx++) {
+        lr_put(&buffer, idx, 1);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    result = lr_put_wait(&buffer, 0, 1, &timeout);
+    test_assert(result == LR_ERROR_TIMEOUT && elapsed_ms(&start) >= 19,
+                "lr_put_wait() should time out after %ld ms",
+                elapsed_ms(&start));
+
+    result = lr_get_wait(&buffer, &data, 1, &timeout);
+    test_assert(result == LR_OK && data == 0,
+                "lr_get_wait() should return available data at once");
+
+    result = lr_put_wait(&buffer, BUFFER_SIZE - 1, 1, &timeout);
+    test_assert(result == LR_OK,
+                "lr_put_wait() should add data when the cell is released");
+
+    lr_clear_owner(&buffer, 1);
+
+    // Test lr_put_wait(): New owner doesn't wait for free cells of the ring
+    // with exhausted reserve
+    lr_init(&buffer, BUFFER_SIZE, cells);
+    lr_set_wait(&buffer, words, WORDS_NR);
+    for (lr_data_t idx = 0; idx < BUFFER_SIZE - 1; idx++) {
+        lr_put(&buffer, idx, 1);
+    }
+    for (lr_data_t idx = 0; idx < BUFFER_SIZE / 2; idx++) {
+        lr_get(&buffer, &data, 1);
+    }
+    test_assert(buffer.reserve == 0, "Reserve should be exhausted");
+
+    for (lr_owner_t owner = 2; owner <= 3; owner++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result = lr_put_wait(&buffer, 0, owner, &timeout);
+        test_assert(result == LR_OK && elapsed_ms(&start) < 19,
+                    "lr_put_wait() should add owner %lu at once",
+                    (unsigned long) owner);
+    }
+
+    for (lr_owner_t owner = 1; owner <= 3; owner++) {
+        lr_clear_owner(&buffer, owner);
+    }
+
+    // Test lr_put_wait(), lr_get_wait(): Producers and consumers block with
+    // the ring-wide mutex
+    struct lr_mutex_attr attr = {
+        .state = &mutex, .lock = mutex_lock, .unlock = mutex_unlock};
+
+    pthread_mutex_init(&mutex, NULL);
+    lr_set_mutex(&buffer, &attr);
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Consumers should get data of their owners in order");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0,
+                "Buffer should be empty when all data is consumed");
+
+    // Test lr_put_wait(), lr_get_wait(): The same with owner locks
+    result = lr_set_owner_locks(&buffer, locks, LOCKS_NR);
+    test_assert(result == LR_OK, "Owner locks should be set");
+
+    result = run_producers_and_consumers();
+    test_assert(result == LR_OK,
+                "Consumers should get data of their owners in order with "
+                "owner locks");
+
+    test_assert(lr_count(&buffer) == 0 && lr_owners_count(&buffer) == 0,
+                "Buffer should be empty when all data is consumed");
+
+    return LR_OK;
+}
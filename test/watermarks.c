@@ -0,0 +1,155 @@
+#include <lr.h> // include header for Linked Ring library
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+
+#define log_print(type, message, ...)                                          \
+    printf(type "\t" message "\n", ##__VA_ARGS__)
+#define log_debug(type, message, ...)                                          \
+    log_print(type, message " (%s:%d)\n", ##__VA_ARGS__, __FILE__, __LINE__)
+#define log_verbose(message, ...) log_print("VERBOSE", message, ##__VA_ARGS__)
+#define log_info(message, ...)    log_print("INFO", message, ##__VA_ARGS__)
+#define log_ok(message, ...)      log_print("OK", message, ##__VA_ARGS__)
+#define log_error(message, ...)                                                \
+    log_print("\e[1m\e[31mERROR\e[39m\e[0m", message " (%s:%d)\n",             \
+              ##__VA_ARGS__, __FILE__, __LINE__)
+
+#define test_assert(test, message, ...)                                        \
+    if (!(test)) {                                                             \
+        log_error(message, ##__VA_ARGS__);                                     \
+        return LR_ERROR_UNKNOWN;                                               \
+    } else {                                                                   \
+        log_ok(message, ##__VA_ARGS__);                                        \
+    }
+
+#define BUFFER_SIZE 16
+#define QUOTAS_NR   4
+#define EVENTS_NR   16
+
+struct linked_ring    buffer;
+struct lr_cell        cells[BUFFER_SIZE];
+struct lr_owner_quota quotas[QUOTAS_NR];
+#if defined(LR_CELL_SOA)
+lr_data_t payload[BUFFER_SIZE];
+    #define lr_init(lr, size, cells) lr_init_soa(lr, size, cells, payload)
+#endif
+
+/* Crossings reported by the callback */
+struct crossing {
+    lr_owner_t        owner;
+    enum lr_watermark crossing;
+} crossings[EVENTS_NR];
+size_t crossings_nr;
+
+void record(void *state, lr_owner_t owner, enum lr_watermark crossing)
+{
+    (void) state;
+
+    if (crossings_nr < EVENTS_NR) {
+        crossings[crossings_nr].owner    = owner;
+        crossings[crossings_nr].crossing = crossing;
+    }
+    crossings_nr++;
+}
+
+/* Put or get elements of the owner */
+void put(lr_owner_t owner, size_t nr)
+{
+    for (size_t idx = 0; idx < nr; idx++) {
+        lr_put(&buffer, idx, owner);
+    }
+}
+
+void get(lr_owner_t owner, size_t nr)
+{
+    lr_data_t data;
+
+    for (size_t idx = 0; idx < nr; idx++) {
+        lr_get(&buffer, &data, owner);
+    }
+}
+
+int main()
+{
+    lr_result_t result;
+
+    result = lr_init(&buffer, BUFFER_SIZE, cells);
+    test_assert(result == LR_OK, "Buffer should be initialized");
+    lr_set_watermark_callback(&buffer, record, NULL);
+
+    // Test lr_set_watermarks(): Low watermark is below the high one
+    result = lr_set_watermarks(&buffer, 6, 6);
+    test_assert(result == LR_ERROR_UNKNOWN,
+                "Low watermark should be less than the high one");
+    result = lr_set_watermarks(&buffer, 2, 6);
+    test_assert(result == LR_OK && !lr_above(&buffer),
+                "Watermarks of the ring should be set");
+
+    // Test lr_put(): Ring reaches the high watermark once
+    put(1, 5);
+    test_assert(crossings_nr == 0 && !lr_above(&buffer),
+                "Ring shouldn't be above the high watermark");
+    put(2, 3);
+    test_assert(crossings_nr == 1 && crossings[0].owner == 2
+                    && crossings[0].crossing == LR_WATERMARK_RING_HIGH
+                    && lr_above(&buffer),
+                "Ring should cross the high watermark once, %lu crossings",
+                (unsigned long) crossings_nr);
+
+    // Test lr_get(): Ring drops to the low watermark
+    get(2, 3);
+    get(1, 2);
+    test_assert(crossings_nr == 1 && lr_above(&buffer),
+                "Ring should stay above until the low watermark");
+    get(1, 1);
+    test_assert(crossings_nr == 2 && crossings[1].owner == 1
+                    && crossings[1].crossing == LR_WATERMARK_RING_LOW
+                    && !lr_above(&buffer),
+                "Ring should drop to the low watermark");
+    lr_set_watermarks(&buffer, 0, 0);
+    lr_clear_owner(&buffer, 1);
+
+    // Test lr_set_owner_watermarks(): Watermarks are kept with quotas
+    result = lr_set_owner_watermarks(&buffer, 1, 1, 3);
+    test_assert(result == LR_ERROR_NOMEMORY,
+                "Watermarks of owner shouldn't be set without quotas");
+    lr_set_quotas(&buffer, quotas, QUOTAS_NR);
+    result = lr_set_owner_watermarks(&buffer, 1, 1, 3);
+    test_assert(result == LR_OK && lr_owner_above(&buffer, 1) == 0,
+                "Watermarks of owner should be set");
+
+    // Test lr_put(): Owner reaches its high watermark
+    crossings_nr = 0;
+    put(2, 4);
+    put(1, 1);
+    test_assert(crossings_nr == 0 && lr_owner_above(&buffer, 2) == 0,
+                "Other owners shouldn't cross watermarks of the owner");
+    put(1, 2);
+    test_assert(crossings_nr == 1 && crossings[0].owner == 1
+                    && crossings[0].crossing == LR_WATERMARK_HIGH
+                    && lr_owner_above(&buffer, 1) == 1,
+                "Owner should cross its high watermark");
+
+    // Test lr_get(): Owner drops to its low watermark
+    get(1, 1);
+    test_assert(crossings_nr == 1 && lr_owner_above(&buffer, 1) == 1,
+                "Owner should stay above until its low watermark");
+    get(1, 1);
+    test_assert(crossings_nr == 2 && crossings[1].crossing == LR_WATERMARK_LOW
+                    && lr_owner_above(&buffer, 1) == 0,
+                "Owner should drop to its low watermark");
+
+    // Test lr_set_owner_watermarks(): Elements of the owner are counted
+    result = lr_set_owner_watermarks(&buffer, 2, 1, 4);
+    test_assert(result == LR_OK && lr_owner_above(&buffer, 2) == 1,
+                "Owner with elements should be above the new watermark");
+    lr_set_owner_watermarks(&buffer, 1, 0, 0);
+    lr_set_owner_watermarks(&buffer, 2, 0, 0);
+    test_assert(lr_owner_above(&buffer, 2) == 0 && quotas[0].high == 0
+                    && quotas[1].high == 0 && quotas[2].high == 0
+                    && quotas[3].high == 0,
+                "Watermarks should be removed");
+
+    return 0;
+}